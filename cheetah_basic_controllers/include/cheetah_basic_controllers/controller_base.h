@@ -12,6 +12,8 @@
 #include <cheetah_common/hardware_interface/hybrid_joint_interface.h>
 #include <cheetah_common/hardware_interface/contact_sensor_interface.h>
 #include <cheetah_common/cpp_types.h>
+#include <cheetah_common/contact_estimator.h>
+#include <cheetah_common/robot_description.h>
 
 #include <cheetah_msgs/LegsCmd.h>
 #include <cheetah_msgs/LegsState.h>
@@ -24,7 +26,7 @@ namespace cheetah_ros
 {
 class ControllerBase
   : public controller_interface::MultiInterfaceController<HybridJointInterface, hardware_interface::ImuSensorInterface,
-                                                          ContactSensorInterface>
+                                                          ContactSensorInterface, HybridJointBlockInterface>
 {
 public:
   struct LegJoints
@@ -38,7 +40,10 @@ public:
     Eigen::Matrix3d kp_cartesian_, kd_cartesian_;
   };
 
-  ControllerBase() = default;
+  // HybridJointBlockInterface is optional, so every interface is checked in init()
+  ControllerBase() : MultiInterfaceController(true)
+  {
+  }
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& controller_nh) override;
   void update(const ros::Time& time, const ros::Duration& period) override;
   void stopping(const ros::Time& /*time*/) override;
@@ -50,6 +55,10 @@ public:
 
 protected:
   void pinocchioKine();
+  // Map the cartesian force of each foot to the feedforward of joints, J^T f by default
+  virtual void updateJointTorque(const Eigen::Vector3d (&foot_force)[4]);
+  // Write the feedforward of the 12 joints, at once if the hardware stores them as a block
+  void setFeedforward(const Vec12<double>& tau);
   void publishState(const ros::Time& time, const ros::Duration& period);
 
   RobotState robot_state_;
@@ -58,6 +67,13 @@ protected:
   std::shared_ptr<urdf::ModelInterface> urdf_;
   std::shared_ptr<pinocchio::Model> pin_model_;
   std::shared_ptr<pinocchio::Data> pin_data_;
+  Eigen::VectorXd pin_q_, pin_v_;  // Configuration and velocity used by the last pinocchioKine()
+  // Legs of the robot, the joints are indexed leg * 3 + joint in the arrays below, the same as the hardware block
+  RobotDescription robot_description_;
+  int q_index_[12]{}, v_index_[12]{};  // Index of every joint in pin_q_ and pin_v_
+  pinocchio::FrameIndex foot_frame_ids_[4]{};
+  // Probability of contact expected by the gait, fused by contact_estimator_ in the next updateData()
+  double contact_expectation_[4]{ 0.5, 0.5, 0.5, 0.5 };
 
 private:
   void legsCmdCallback(const cheetah_msgs::LegsCmd::ConstPtr& msg);
@@ -65,6 +81,10 @@ private:
   LegJoints leg_joints_[4];
   LegCmd leg_cmd_[4];
   ContactSensorHandle feet_contact_;
+  HybridJointBlockHandle leg_joint_block_;
+  bool has_joint_block_{ false };
+  // Refine the contact of the hardware with the kinematics and the gait, nullptr to use the contact of the hardware
+  std::shared_ptr<ContactEstimator<double>> contact_estimator_;
 
   ros::Subscriber legs_cmd_sub_;
   realtime_tools::RealtimeBuffer<cheetah_msgs::LegsCmd> legs_cmd_buffer_;
@@ -35,6 +35,9 @@ public:
   void updateCommand(const ros::Time& time, const ros::Duration& period) override;
   TouchState getFootState(LegPrefix leg);
   void setSwing(LegPrefix leg, const Eigen::Vector3d& final_pos, double height, double swing_time);
+  // Move the landing position of the current swing without restarting it
+  void setSwingFinalPosition(LegPrefix leg, const Eigen::Vector3d& final_pos);
+  double getSwingRemainTime(LegPrefix leg);
   void setStand(LegPrefix leg, const Eigen::Vector3d& force);
 
 private:
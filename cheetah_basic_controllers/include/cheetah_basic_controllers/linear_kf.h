@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cheetah_common/cpp_types.h>
+#include <cheetah_common/math_utilities.h>
+
+namespace cheetah_ros
+{
+/*!
+ * Linear kalman filter of the position and the velocity of the base, the same as the one of MIT Cheetah-Software.
+ * The state is [pos, vel, foot_pos * 4] in world frame, the measurements are the foot positions and velocities
+ * relative to the base and the foot heights. Free of ROS so that it is shared by LinearKFPosVelEstimator and the
+ * accuracy test of the single precision build.
+ */
+template <typename T>
+class LinearKFPosVel
+{
+public:
+  explicit LinearKFPosVel(T dt = 0.001)
+  {
+    x_hat_.setZero();
+    ps_.setZero();
+    vs_.setZero();
+    a_.setZero();
+    a_.template block<3, 3>(0, 0) = Mat3<T>::Identity();
+    a_.template block<3, 3>(0, 3) = dt * Mat3<T>::Identity();
+    a_.template block<3, 3>(3, 3) = Mat3<T>::Identity();
+    a_.template block<12, 12>(6, 6) = Mat12<T>::Identity();
+    b_.setZero();
+    b_.template block<3, 3>(0, 0) = T(0.5) * dt * dt * Mat3<T>::Identity();
+    b_.template block<3, 3>(3, 0) = dt * Mat3<T>::Identity();
+
+    Eigen::Matrix<T, 3, 6> c1, c2;
+    c1 << Mat3<T>::Identity(), Mat3<T>::Zero();
+    c2 << Mat3<T>::Zero(), Mat3<T>::Identity();
+    c_.setZero();
+    c_.template block<3, 6>(0, 0) = c1;
+    c_.template block<3, 6>(3, 0) = c1;
+    c_.template block<3, 6>(6, 0) = c1;
+    c_.template block<3, 6>(9, 0) = c1;
+    c_.template block<12, 12>(0, 6) = Mat12<T>::Identity();
+    c_.template block<3, 6>(12, 0) = c2;
+    c_.template block<3, 6>(15, 0) = c2;
+    c_.template block<3, 6>(18, 0) = c2;
+    c_.template block<3, 6>(21, 0) = c2;
+    c_(27, 17) = 1.0;
+    c_(26, 14) = 1.0;
+    c_(25, 11) = 1.0;
+    c_(24, 8) = 1.0;
+    p_.setIdentity();
+    p_ = T(100.) * p_;
+    q_.setIdentity();
+    q_.template block<3, 3>(0, 0) = (dt / T(20.)) * Mat3<T>::Identity();
+    q_.template block<3, 3>(3, 3) = (dt * T(9.81) / T(20.)) * Mat3<T>::Identity();
+    q_.template block<12, 12>(6, 6) = dt * Mat12<T>::Identity();
+    r_.setIdentity();
+  }
+
+  // Update the position and the linear velocity of the state, from the orientation, the acceleration and the feet
+  void update(RobotStateTpl<T>& state)
+  {
+    T imu_process_noise_position = 0.02;
+    T imu_process_noise_velocity = 0.02;
+    T foot_process_noise_position = 0.002;
+    T foot_sensor_noise_position = 0.001;
+    T foot_sensor_noise_velocity = 0.1;
+    T foot_height_sensor_noise = 0.001;
+    Mat18<T> q = Mat18<T>::Identity();
+    q.template block<3, 3>(0, 0) = q_.template block<3, 3>(0, 0) * imu_process_noise_position;
+    q.template block<3, 3>(3, 3) = q_.template block<3, 3>(3, 3) * imu_process_noise_velocity;
+    q.template block<12, 12>(6, 6) = q_.template block<12, 12>(6, 6) * foot_process_noise_position;
+
+    Mat28<T> r = Mat28<T>::Identity();
+    r.template block<12, 12>(0, 0) = r_.template block<12, 12>(0, 0) * foot_sensor_noise_position;
+    r.template block<12, 12>(12, 12) = r_.template block<12, 12>(12, 12) * foot_sensor_noise_velocity;
+    r.template block<4, 4>(24, 24) = r_.template block<4, 4>(24, 24) * foot_height_sensor_noise;
+
+    for (int i = 0; i < 4; i++)
+    {
+      int i1 = 3 * i;
+
+      int q_index = 6 + i1;
+      int r_index2 = 12 + i1;
+      int r_index3 = 24 + i;
+
+      T high_suspect_number(100);
+      T suspect = state.contact_state_[i] ? T(1.) : high_suspect_number;
+      q.template block<3, 3>(q_index, q_index) *= suspect;
+      r.template block<3, 3>(r_index2, r_index2) *= suspect;
+      r(r_index3, r_index3) *= suspect;
+
+      ps_.template segment<3>(3 * i) = state.pos_ - state.foot_pos_[i];
+      vs_.template segment<3>(3 * i) = state.linear_vel_ - state.foot_vel_[i];
+    }
+
+    Vec3<T> g(0, 0, -9.81);
+    Vec3<T> accel = quaternionToRotationMatrix(state.quat_) * state.accel_ + g;
+    Vec4<T> pzs = T(-0.0265) * Vec4<T>::Ones();
+
+    Vec28<T> y;
+    y << ps_, vs_, pzs;
+    x_hat_ = a_ * x_hat_ + b_ * accel;
+    Mat18<T> at = a_.transpose();
+    Mat18<T> pm = a_ * p_ * at + q;
+    Eigen::Matrix<T, 18, 28> ct = c_.transpose();
+    Vec28<T> y_model = c_ * x_hat_;
+    Vec28<T> ey = y - y_model;
+    Mat28<T> s = c_ * pm * ct + r;
+
+    Vec28<T> s_ey = s.lu().solve(ey);
+    x_hat_ += pm * ct * s_ey;
+
+    Eigen::Matrix<T, 28, 18> s_c = s.lu().solve(c_);
+    p_ = (Mat18<T>::Identity() - pm * ct * s_c) * pm;
+
+    Mat18<T> pt = p_.transpose();
+    p_ = (p_ + pt) / T(2.0);
+
+    if (p_.template block<2, 2>(0, 0).determinant() > T(0.000001))
+    {
+      p_.template block<2, 16>(0, 2).setZero();
+      p_.template block<16, 2>(2, 0).setZero();
+      p_.template block<2, 2>(0, 0) /= T(10.);
+    }
+
+    state.pos_ = x_hat_.template segment<3>(0);
+    state.linear_vel_ = x_hat_.template segment<3>(3);
+  }
+
+private:
+  Vec18<T> x_hat_;
+  Vec12<T> ps_;
+  Vec12<T> vs_;
+  Mat18<T> a_;
+  Mat18<T> q_;
+  Mat18<T> p_;
+  Mat28<T> r_;
+  Eigen::Matrix<T, 18, 3> b_;
+  Eigen::Matrix<T, 28, 18> c_;
+};
+
+}  // namespace cheetah_ros
@@ -11,6 +11,7 @@
 #include <tf2_ros/transform_broadcaster.h>
 
 #include <cheetah_common/cpp_types.h>
+#include "linear_kf.h"
 
 namespace cheetah_ros
 {
@@ -49,15 +50,7 @@ public:
   void update(ros::Time time, RobotState& state) override;
 
 private:
-  Eigen::Matrix<double, 18, 1> x_hat_;
-  Eigen::Matrix<double, 12, 1> ps_;
-  Eigen::Matrix<double, 12, 1> vs_;
-  Eigen::Matrix<double, 18, 18> a_;
-  Eigen::Matrix<double, 18, 18> q_;
-  Eigen::Matrix<double, 18, 18> p_;
-  Eigen::Matrix<double, 28, 28> r_;
-  Eigen::Matrix<double, 18, 3> b_;
-  Eigen::Matrix<double, 28, 18> c_;
+  LinearKFPosVel<ControlScalar> kf_;
 };
 
 class ImuSensorEstimator : public StateEstimateBase
@@ -4,6 +4,8 @@
 
 #include "cheetah_basic_controllers/controller_base.h"
 
+#include <cheetah_common/ros_utilities.h>
+
 #include <pinocchio/algorithm/kinematics.hpp>
 #include <pinocchio/algorithm/frames.hpp>
 #include <pinocchio/algorithm/jacobian.hpp>
@@ -26,12 +28,69 @@ bool ControllerBase::init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle
     pinocchio::urdf::buildModel(urdf_, pinocchio::JointModelFreeFlyer(), *pin_model_);
     pin_data_ = std::make_shared<pinocchio::Data>(*pin_model_);
   }
-  // Setup joint handles. Ignore id 0 (universe joint) and id 1 (root joint).
+  pin_q_.resize(pin_model_->nq);
+  pin_v_.resize(pin_model_->nv);
   HybridJointInterface* hybrid_joint_interface = robot_hw->get<HybridJointInterface>();
+  if (hybrid_joint_interface == nullptr || robot_hw->get<hardware_interface::ImuSensorInterface>() == nullptr ||
+      robot_hw->get<ContactSensorInterface>() == nullptr)
+  {
+    ROS_ERROR("The hardware does not provide the hybrid joint, imu or contact sensor interface");
+    return false;
+  }
+  // Map the legs to the pinocchio model once, the loops of update() only use the indices
+  if (!robot_description_.init(controller_nh, pin_model_->names))
+    return false;
+  if (robot_description_.getNumLegs() != 4 || robot_description_.getJointsPerLeg() != 3 || pin_model_->nv != 18)
+  {
+    ROS_ERROR("The controllers support a floating base with 4 legs of 3 joints, check /robot_legs");
+    return false;
+  }
+  for (int i = 0; i < 12; ++i)
+  {
+    const std::string& name = robot_description_.getJointName(i);
+    const pinocchio::JointModel& joint = pin_model_->joints[pin_model_->getJointId(name)];
+    if (joint.nq() != 1 || joint.nv() != 1)
+    {
+      ROS_ERROR_STREAM("The joint " << name << " is not a revolute or prismatic joint");
+      return false;
+    }
+    q_index_[i] = joint.idx_q();
+    v_index_[i] = joint.idx_v();
+  }
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    if (!pin_model_->existFrame(robot_description_.getFootName(leg)))
+    {
+      ROS_ERROR_STREAM("Can not find the foot " << robot_description_.getFootName(leg) << " in the urdf");
+      return false;
+    }
+    foot_frame_ids_[leg] = pin_model_->getFrameId(robot_description_.getFootName(leg));
+  }
   for (int leg = 0; leg < 4; ++leg)
     for (int j = 0; j < 3; ++j)
-      leg_joints_[leg].joints_[j] = hybrid_joint_interface->getHandle(pin_model_->names[2 + leg * 3 + j]);
+      leg_joints_[leg].joints_[j] = hybrid_joint_interface->getHandle(robot_description_.getJointName(leg * 3 + j));
+  // The block of the hardware is in the same order as the robot description
+  HybridJointBlockInterface* hybrid_joint_block_interface = robot_hw->get<HybridJointBlockInterface>();
+  if (hybrid_joint_block_interface != nullptr)
+  {
+    leg_joint_block_ = hybrid_joint_block_interface->getHandle("legs");
+    has_joint_block_ = leg_joint_block_.getSize() == 12;
+  }
   feet_contact_ = robot_hw->get<ContactSensorInterface>()->getHandle("feet");
+  if (getParam(controller_nh, "contact/enable", false))
+  {
+    contact_estimator_ = std::make_shared<ContactEstimator<double>>();
+    contact_estimator_->setKinematics(getParam(controller_nh, "contact/height_scale", 0.03),
+                                      getParam(controller_nh, "contact/vel_scale", 0.3),
+                                      getParam(controller_nh, "contact/kinematic_weight", 2.));
+    contact_estimator_->setHysteresis(getParam(controller_nh, "contact/high", 0.7),
+                                      getParam(controller_nh, "contact/low", 0.3));
+    for (int leg = 0; leg < 4; ++leg)  // No kinematics before the first tick
+    {
+      robot_state_.foot_pos_[leg].setZero();
+      robot_state_.foot_vel_[leg].setZero();
+    }
+  }
 
   // ROS Topic
   legs_cmd_sub_ =
@@ -66,8 +125,28 @@ void ControllerBase::stopping(const ros::Time& /*time*/)
 
 void ControllerBase::updateData(const ros::Time& time, const ros::Duration& period)
 {
-  for (int i = 0; i < 4; ++i)
-    robot_state_.contact_state_[i] = feet_contact_.getIsContact()[i];
+  const bool* is_contact = feet_contact_.getIsContact();
+  const double* force = feet_contact_.getForce();
+  for (int leg = 0; leg < 4; ++leg)
+    robot_state_.contact_force_[leg] = force ? force[leg] : 0.;
+  if (contact_estimator_ != nullptr)
+  {
+    // The kinematics is the one of the last tick, the estimate of this tick needs the contact
+    const double* probability = feet_contact_.getProbability();
+    contact_estimator_->begin();
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      contact_estimator_->addProbability(leg, probability ? probability[leg] : (is_contact[leg] ? 1. : 0.));
+      contact_estimator_->addProbability(leg, contact_expectation_[leg]);
+      contact_estimator_->addKinematics(leg, robot_state_.foot_pos_[leg].z(), robot_state_.foot_vel_[leg].z());
+    }
+    contact_estimator_->end();
+    for (int leg = 0; leg < 4; ++leg)
+      robot_state_.contact_state_[leg] = contact_estimator_->isContact(leg);
+  }
+  else
+    for (int i = 0; i < 4; ++i)
+      robot_state_.contact_state_[i] = is_contact[i];
 
   if (angular_estimate_ != nullptr)
   {
@@ -99,34 +178,56 @@ void ControllerBase::updateCommand(const ros::Time& time, const ros::Duration& p
   }
 
   // Update joint space command
+  Eigen::Vector3d foot_force[4];
   for (int leg = 0; leg < 4; ++leg)
   {
-    Eigen::Vector3d foot_force = leg_cmd_[leg].ff_cartesian_;
+    foot_force[leg] = leg_cmd_[leg].ff_cartesian_;
     // cartesian PD
-    foot_force += leg_cmd_[leg].kp_cartesian_ * (leg_cmd_[leg].foot_pos_des_ - robot_state_.foot_pos_[leg]);
-    foot_force += leg_cmd_[leg].kd_cartesian_ * (leg_cmd_[leg].foot_vel_des_ - robot_state_.foot_vel_[leg]);
+    foot_force[leg] += leg_cmd_[leg].kp_cartesian_ * (leg_cmd_[leg].foot_pos_des_ - robot_state_.foot_pos_[leg]);
+    foot_force[leg] += leg_cmd_[leg].kd_cartesian_ * (leg_cmd_[leg].foot_vel_des_ - robot_state_.foot_vel_[leg]);
+  }
+  updateJointTorque(foot_force);
+}
+
+void ControllerBase::updateJointTorque(const Eigen::Vector3d (&foot_force)[4])
+{
+  Vec12<double> tau_joints;
+  for (int leg = 0; leg < 4; ++leg)
+  {
     Eigen::Matrix<double, 6, 18> jac;
-    pinocchio::getFrameJacobian(*pin_model_, *pin_data_, pin_model_->getFrameId(LEG_PREFIX[leg] + "_foot"),
+    pinocchio::getFrameJacobian(*pin_model_, *pin_data_, foot_frame_ids_[leg],
                                 pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED, jac);
     Eigen::Matrix<double, 6, 1> wrench;
     wrench.setZero();
-    wrench.head(3) = foot_force;
+    wrench.head(3) = foot_force[leg];
     Eigen::Matrix<double, 18, 1> tau = jac.transpose() * wrench;
     for (int joint = 0; joint < 3; ++joint)
-      leg_joints_[leg].joints_[joint].setFeedforward(tau(6 + leg * 3 + joint));
+      tau_joints(leg * 3 + joint) = tau(v_index_[leg * 3 + joint]);
   }
+  setFeedforward(tau_joints);
+}
+
+void ControllerBase::setFeedforward(const Vec12<double>& tau)
+{
+  if (has_joint_block_)
+    leg_joint_block_.setFeedforward(tau.data());
+  else
+    for (int leg = 0; leg < 4; ++leg)
+      for (int joint = 0; joint < 3; ++joint)
+        leg_joints_[leg].joints_[joint].setFeedforward(tau(leg * 3 + joint));
 }
 
 void ControllerBase::pinocchioKine()
 {
-  Eigen::VectorXd q(pin_model_->nq), v(pin_model_->nv);
+  Eigen::VectorXd& q = pin_q_;
+  Eigen::VectorXd& v = pin_v_;
   for (int leg = 0; leg < 4; ++leg)
     for (int joint = 0; joint < 3; ++joint)
     {
       // Free-flyer joints have 6 degrees of freedom, but are represented by 7 scalars: the position of the basis center
       // in the world frame, and the orientation of the basis in the world frame stored as a quaternion.
-      q(7 + leg * 3 + joint) = leg_joints_[leg].joints_[joint].getPosition();
-      v(6 + leg * 3 + joint) = leg_joints_[leg].joints_[joint].getVelocity();
+      q(q_index_[leg * 3 + joint]) = leg_joints_[leg].joints_[joint].getPosition();
+      v(v_index_[leg * 3 + joint]) = leg_joints_[leg].joints_[joint].getVelocity();
     }
   q.head(7) << robot_state_.pos_, robot_state_.quat_.coeffs();
   v.head(6) << robot_state_.linear_vel_, robot_state_.angular_vel_;
@@ -136,7 +237,7 @@ void ControllerBase::pinocchioKine()
   pinocchio::updateFramePlacements(*pin_model_, *pin_data_);
   for (int leg = 0; leg < 4; ++leg)
   {
-    pinocchio::FrameIndex frame_id = pin_model_->getFrameId(LEG_PREFIX[leg] + "_foot");
+    pinocchio::FrameIndex frame_id = foot_frame_ids_[leg];
     robot_state_.foot_pos_[leg] = pin_data_->oMf[frame_id].translation();
     robot_state_.foot_vel_[leg] =
         pinocchio::getFrameVelocity(*pin_model_, *pin_data_, frame_id, pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED)
@@ -103,6 +103,16 @@ void FeetController::setSwing(LegPrefix leg, const Eigen::Vector3d& final_pos, d
   swing_trajectory_[leg].setFinalPosition(final_pos);
 }
 
+void FeetController::setSwingFinalPosition(LegPrefix leg, const Eigen::Vector3d& final_pos)
+{
+  swing_trajectory_[leg].setFinalPosition(final_pos);
+}
+
+double FeetController::getSwingRemainTime(LegPrefix leg)
+{
+  return (1. - states_[leg].phase_) * states_[leg].swing_time_;
+}
+
 void FeetController::setStand(LegPrefix leg, const Eigen::Vector3d& force)
 {
   states_[leg].touch_state_ = STAND;
@@ -72,119 +72,32 @@ void FromTopicStateEstimate::update(ros::Time time, RobotState& state)
   StateEstimateBase::update(time, state);
 }
 
-LinearKFPosVelEstimator::LinearKFPosVelEstimator(ros::NodeHandle& nh) : StateEstimateBase(nh)
+LinearKFPosVelEstimator::LinearKFPosVelEstimator(ros::NodeHandle& nh) : StateEstimateBase(nh), kf_(0.001)
 {
-  double dt = 0.001;
-  x_hat_.setZero();
-  ps_.setZero();
-  vs_.setZero();
-  a_.setZero();
-  a_.block(0, 0, 3, 3) = Eigen::Matrix<double, 3, 3>::Identity();
-  a_.block(0, 3, 3, 3) = dt * Eigen::Matrix<double, 3, 3>::Identity();
-  a_.block(3, 3, 3, 3) = Eigen::Matrix<double, 3, 3>::Identity();
-  a_.block(6, 6, 12, 12) = Eigen::Matrix<double, 12, 12>::Identity();
-  b_.setZero();
-  b_.block(0, 0, 3, 3) = 0.5 * dt * dt * Eigen::Matrix<double, 3, 3>::Identity();
-  b_.block(3, 0, 3, 3) = dt * Eigen::Matrix<double, 3, 3>::Identity();
-
-  Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> c1(3, 6);
-  c1 << Eigen::Matrix<double, 3, 3>::Identity(), Eigen::Matrix<double, 3, 3>::Zero();
-  Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> c2(3, 6);
-  c2 << Eigen::Matrix<double, 3, 3>::Zero(), Eigen::Matrix<double, 3, 3>::Identity();
-  c_.setZero();
-  c_.block(0, 0, 3, 6) = c1;
-  c_.block(3, 0, 3, 6) = c1;
-  c_.block(6, 0, 3, 6) = c1;
-  c_.block(9, 0, 3, 6) = c1;
-  c_.block(0, 6, 12, 12) = Eigen::Matrix<double, 12, 12>::Identity();
-  c_.block(12, 0, 3, 6) = c2;
-  c_.block(15, 0, 3, 6) = c2;
-  c_.block(18, 0, 3, 6) = c2;
-  c_.block(21, 0, 3, 6) = c2;
-  c_(27, 17) = 1.0;
-  c_(26, 14) = 1.0;
-  c_(25, 11) = 1.0;
-  c_(24, 8) = 1.0;
-  p_.setIdentity();
-  p_ = 100. * p_;
-  q_.setIdentity();
-  q_.block(0, 0, 3, 3) = (dt / 20.f) * Eigen::Matrix<double, 3, 3>::Identity();
-  q_.block(3, 3, 3, 3) = (dt * 9.81f / 20.f) * Eigen::Matrix<double, 3, 3>::Identity();
-  q_.block(6, 6, 12, 12) = dt * Eigen::Matrix<double, 12, 12>::Identity();
-  r_.setIdentity();
 }
 
-void LinearKFPosVelEstimator::update(ros::Time time, RobotState& state)
+namespace
 {
-  double imu_process_noise_position = 0.02;
-  double imu_process_noise_velocity = 0.02;
-  double foot_process_noise_position = 0.002;
-  double foot_sensor_noise_position = 0.001;
-  double foot_sensor_noise_velocity = 0.1;
-  double foot_height_sensor_noise = 0.001;
-  Eigen::Matrix<double, 18, 18> q = Eigen::Matrix<double, 18, 18>::Identity();
-  q.block(0, 0, 3, 3) = q_.block(0, 0, 3, 3) * imu_process_noise_position;
-  q.block(3, 3, 3, 3) = q_.block(3, 3, 3, 3) * imu_process_noise_velocity;
-  q.block(6, 6, 12, 12) = q_.block(6, 6, 12, 12) * foot_process_noise_position;
-
-  Eigen::Matrix<double, 28, 28> r = Eigen::Matrix<double, 28, 28>::Identity();
-  r.block(0, 0, 12, 12) = r_.block(0, 0, 12, 12) * foot_sensor_noise_position;
-  r.block(12, 12, 12, 12) = r_.block(12, 12, 12, 12) * foot_sensor_noise_velocity;
-  r.block(24, 24, 4, 4) = r_.block(24, 24, 4, 4) * foot_height_sensor_noise;
-
-  for (int i = 0; i < 4; i++)
-  {
-    int i1 = 3 * i;
-
-    int q_index = 6 + i1;
-    int r_index1 = i1;
-    int r_index2 = 12 + i1;
-    int r_index3 = 24 + i;
-
-    double high_suspect_number(100);
-    q.block(q_index, q_index, 3, 3) =
-        (state.contact_state_[i] ? 1. : high_suspect_number) * q.block(q_index, q_index, 3, 3);
-    r.block(r_index1, r_index1, 3, 3) = 1. * r.block(r_index1, r_index1, 3, 3);
-    r.block(r_index2, r_index2, 3, 3) =
-        (state.contact_state_[i] ? 1. : high_suspect_number) * r.block(r_index2, r_index2, 3, 3);
-    r(r_index3, r_index3) = (state.contact_state_[i] ? 1. : high_suspect_number) * r(r_index3, r_index3);
-
-    ps_.segment(3 * i, 3) = state.pos_ - state.foot_pos_[i];
-    vs_.segment(3 * i, 3) = state.linear_vel_ - state.foot_vel_[i];
-  }
-
-  Vec3<double> g(0, 0, -9.81);
-  Vec3<double> accel = quaternionToRotationMatrix(state.quat_) * state.accel_ + g;
-  Vec4<double> pzs = -0.0265 * Vec4<double>::Ones();
-
-  Eigen::Matrix<double, 28, 1> y;
-  y << ps_, vs_, pzs;
-  x_hat_ = a_ * x_hat_ + b_ * accel;
-  Eigen::Matrix<double, 18, 18> at = a_.transpose();
-  Eigen::Matrix<double, 18, 18> pm = a_ * p_ * at + q;
-  Eigen::Matrix<double, 18, 28> ct = c_.transpose();
-  Eigen::Matrix<double, 28, 1> y_model = c_ * x_hat_;
-  Eigen::Matrix<double, 28, 1> ey = y - y_model;
-  Eigen::Matrix<double, 28, 28> s = c_ * pm * ct + r;
-
-  Eigen::Matrix<double, 28, 1> s_ey = s.lu().solve(ey);
-  x_hat_ += pm * ct * s_ey;
-
-  Eigen::Matrix<double, 28, 18> s_c = s.lu().solve(c_);
-  p_ = (Eigen::Matrix<double, 18, 18>::Identity() - pm * ct * s_c) * pm;
-
-  Eigen::Matrix<double, 18, 18> pt = p_.transpose();
-  p_ = (p_ + pt) / 2.0;
+// The filter in double updates the state in place
+void updateKf(LinearKFPosVel<double>& kf, RobotState& state)
+{
+  kf.update(state);
+}
 
-  if (p_.block(0, 0, 2, 2).determinant() > 0.000001)
-  {
-    p_.block(0, 2, 2, 16).setZero();
-    p_.block(2, 0, 16, 2).setZero();
-    p_.block(0, 0, 2, 2) /= 10.;
-  }
+// The single precision filter works on a copy of the state
+template <typename T>
+void updateKf(LinearKFPosVel<T>& kf, RobotState& state)
+{
+  RobotStateTpl<T> kf_state = state.cast<T>();
+  kf.update(kf_state);
+  state.pos_ = kf_state.pos_.template cast<double>();
+  state.linear_vel_ = kf_state.linear_vel_.template cast<double>();
+}
+}  // namespace
 
-  state.pos_ = x_hat_.block(0, 0, 3, 1);
-  state.linear_vel_ = x_hat_.block(3, 0, 3, 1);
+void LinearKFPosVelEstimator::update(ros::Time time, RobotState& state)
+{
+  updateKf(kf_, state);
 
   StateEstimateBase::update(time, state);
 }
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+namespace cheetah_ros
+{
+/*!
+ * Probabilistic contact detection of the four feet. The pieces of evidence of one tick are fused as a sum of log-odds
+ * (naive Bayes with a uniform prior), then a hysteresis turns the probability into the contact state.
+ *
+ * Usage every tick: begin(), any of addForce() / addProbability() / addKinematics() per foot, end().
+ */
+template <typename T>
+class ContactEstimator
+{
+public:
+  ContactEstimator()
+  {
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      setForceCalibration(leg, 0., 10., 5.);
+      probability_[leg] = 0.5;  // The prior, not a sure swing which would track the offset of a loaded foot
+    }
+  }
+
+  /*!
+   * Per foot calibration of the force sensor, the force evidence is 0.5 at offset + threshold
+   * @param offset : reading of the unloaded foot
+   * @param threshold : load above the offset at which the foot is as likely in contact as not
+   * @param scale : load change which multiplies the odds by e
+   */
+  void setForceCalibration(int leg, T offset, T threshold, T scale)
+  {
+    force_offset_[leg] = offset;
+    force_threshold_[leg] = threshold;
+    force_scale_[leg] = scale;
+  }
+
+  // Enter the contact above high, leave it below low
+  void setHysteresis(T high, T low)
+  {
+    high_ = high;
+    low_ = low;
+  }
+
+  /*!
+   * @param height_scale : foot height above the last touchdown at which the kinematics is certain of a swing
+   * @param vel_scale : vertical foot speed at which the kinematics is certain of a swing
+   * @param max_log_odds : weight of the kinematic evidence
+   */
+  void setKinematics(T height_scale, T vel_scale, T max_log_odds)
+  {
+    height_scale_ = height_scale;
+    vel_scale_ = vel_scale;
+    kinematic_log_odds_ = max_log_odds;
+  }
+
+  // Track the force offset with this rate per tick while the foot is surely in the air, 0 to disable
+  void setOffsetTracking(T rate)
+  {
+    offset_rate_ = rate;
+  }
+
+  void begin()
+  {
+    for (T& log_odds : log_odds_)
+      log_odds = 0.;
+  }
+
+  void addForce(int leg, T force)
+  {
+    if (!contact_[leg] && probability_[leg] < SURE_SWING)
+      force_offset_[leg] += offset_rate_ * (force - force_offset_[leg]);
+    T log_odds = (force - force_offset_[leg] - force_threshold_[leg]) / force_scale_[leg];
+    log_odds_[leg] += std::min(std::max(log_odds, T(-MAX_LOG_ODDS)), T(MAX_LOG_ODDS));
+  }
+
+  // E.g. the expectation of the gait or the probability estimated by another estimator
+  void addProbability(int leg, T probability)
+  {
+    probability = std::min(std::max(probability, T(MIN_PROBABILITY)), T(1. - MIN_PROBABILITY));
+    log_odds_[leg] += std::log(probability / (T(1.) - probability));
+  }
+
+  /*!
+   * Evidence of the foot motion, positive when the foot stays still at the height of the last touchdown
+   * @param height : foot height in world frame
+   * @param vertical_vel : foot velocity along z in world frame
+   */
+  void addKinematics(int leg, T height, T vertical_vel)
+  {
+    T distance = std::abs(height - touchdown_height_[leg]) / height_scale_ + std::abs(vertical_vel) / vel_scale_;
+    log_odds_[leg] += kinematic_log_odds_ * (T(1.) - T(2.) * std::min(distance, T(1.)));
+    height_[leg] = height;
+  }
+
+  void end()
+  {
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      probability_[leg] = T(1.) / (T(1.) + std::exp(-log_odds_[leg]));
+      bool contact = contact_[leg] ? probability_[leg] > low_ : probability_[leg] > high_;
+      if (contact && !contact_[leg])
+        touchdown_height_[leg] = height_[leg];
+      contact_[leg] = contact;
+    }
+  }
+
+  T getProbability(int leg) const
+  {
+    return probability_[leg];
+  }
+
+  bool isContact(int leg) const
+  {
+    return contact_[leg];
+  }
+
+  T getForceOffset(int leg) const
+  {
+    return force_offset_[leg];
+  }
+
+private:
+  static constexpr T MAX_LOG_ODDS = 10.;
+  static constexpr T MIN_PROBABILITY = 0.01;
+  static constexpr T SURE_SWING = 0.05;
+
+  T force_offset_[4], force_threshold_[4], force_scale_[4];
+  T high_{ 0.7 }, low_{ 0.3 };
+  T height_scale_{ 0.03 }, vel_scale_{ 0.3 }, kinematic_log_odds_{ 2. };
+  T offset_rate_{};
+
+  T log_odds_[4]{}, probability_[4]{}, height_[4]{}, touchdown_height_[4]{};
+  bool contact_[4]{};
+};
+
+}  // namespace cheetah_ros
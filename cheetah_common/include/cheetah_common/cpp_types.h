@@ -7,13 +7,7 @@
 #include <vector>
 #include <eigen3/Eigen/Dense>
 
-struct RobotState
-{
-  Eigen::Quaterniond quat_;
-  Eigen::Vector3d pos_, linear_vel_, angular_vel_, accel_;
-  Eigen::Vector3d foot_pos_[4], foot_vel_[4];
-  bool contact_state_[4];
-};
+#include <cheetah_common/config.h>
 
 enum LegPrefix
 {
@@ -128,3 +122,42 @@ using D3Mat = typename Eigen::Matrix<T, 3, Eigen::Dynamic>;
 // std::vector (a list) of Eigen things
 template <typename T>
 using vectorAligned = typename std::vector<T, Eigen::aligned_allocator<T>>;
+
+// Scalar of the state estimator and the mpc formulation, single precision with the CHEETAH_FLOAT32 option of cheetah_common
+#ifdef CHEETAH_FLOAT32
+using ControlScalar = float;
+#else
+using ControlScalar = double;
+#endif
+
+template <typename T>
+struct RobotStateTpl
+{
+  Eigen::Quaternion<T> quat_;
+  Vec3<T> pos_, linear_vel_, angular_vel_, accel_;
+  Vec3<T> foot_pos_[4], foot_vel_[4];
+  bool contact_state_[4];
+  T contact_force_[4];  // Normal force on the feet, zero when the hardware does not sense it
+
+  template <typename U>
+  RobotStateTpl<U> cast() const
+  {
+    RobotStateTpl<U> state;
+    state.quat_ = quat_.template cast<U>();
+    state.pos_ = pos_.template cast<U>();
+    state.linear_vel_ = linear_vel_.template cast<U>();
+    state.angular_vel_ = angular_vel_.template cast<U>();
+    state.accel_ = accel_.template cast<U>();
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      state.foot_pos_[leg] = foot_pos_[leg].template cast<U>();
+      state.foot_vel_[leg] = foot_vel_[leg].template cast<U>();
+      state.contact_state_[leg] = contact_state_[leg];
+      state.contact_force_[leg] = static_cast<U>(contact_force_[leg]);
+    }
+    return state;
+  }
+};
+
+// The controllers stay in double, the same as pinocchio
+using RobotState = RobotStateTpl<double>;
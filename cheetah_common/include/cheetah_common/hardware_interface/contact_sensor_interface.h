@@ -12,7 +12,10 @@ class ContactSensorHandle
 public:
   ContactSensorHandle() = default;
 
-  ContactSensorHandle(const std::string& name, const bool* is_contact) : name_(name), is_contact_(is_contact)
+  // The probability and the normal force are optional, for the hardware which estimates or senses them
+  ContactSensorHandle(const std::string& name, const bool* is_contact, const double* probability = nullptr,
+                      const double* force = nullptr)
+    : name_(name), is_contact_(is_contact), probability_(probability), force_(force)
   {
     if (!is_contact)
     {
@@ -32,10 +35,24 @@ public:
     return is_contact_;
   }
 
+  // The probability of contact of the four feet, nullptr when the hardware does not estimate it
+  const double* getProbability()
+  {
+    return probability_;
+  }
+
+  // The normal force on the four feet, nullptr when the hardware does not sense it
+  const double* getForce()
+  {
+    return force_;
+  }
+
 private:
   std::string name_;
 
   const bool* is_contact_ = { nullptr };
+  const double* probability_ = { nullptr };
+  const double* force_ = { nullptr };
 };
 
 class ContactSensorInterface
@@ -2,6 +2,8 @@
 // Created by qiayuan on 2021/11/5.
 //
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <hardware_interface/internal/hardware_resource_manager.h>
 #include <hardware_interface/joint_state_interface.h>
 
@@ -12,8 +14,21 @@ class HybridJointHandle : public hardware_interface::JointStateHandle
 public:
   HybridJointHandle() = default;
 
-  HybridJointHandle(const JointStateHandle& js, double* pos_des, double* vel_des, double* kp, double* kd, double* ff)
-    : JointStateHandle(js), pos_des_(pos_des), vel_des_(vel_des), kp_(kp), kd_(kd), ff_(ff)
+  /*!
+   * @param generation : optional, the current cycle of the hardware
+   * @param cmd_generation : optional, set to generation by every setter, so the hardware knows whether the command was
+   * updated in this cycle
+   */
+  HybridJointHandle(const JointStateHandle& js, double* pos_des, double* vel_des, double* kp, double* kd, double* ff,
+                    const uint64_t* generation = nullptr, uint64_t* cmd_generation = nullptr)
+    : JointStateHandle(js)
+    , pos_des_(pos_des)
+    , vel_des_(vel_des)
+    , kp_(kp)
+    , kd_(kd)
+    , ff_(ff)
+    , generation_(generation)
+    , cmd_generation_(cmd_generation)
   {
     if (!pos_des_)
     {
@@ -40,31 +55,41 @@ public:
       throw hardware_interface::HardwareInterfaceException("Cannot create handle '" + js.getName() +
                                                            "'. Feedforward data pointer is null.");
     }
+    if ((generation_ == nullptr) != (cmd_generation_ == nullptr))
+    {
+      throw hardware_interface::HardwareInterfaceException("Cannot create handle '" + js.getName() +
+                                                           "'. Only one of the generation pointers is null.");
+    }
   }
   void setPositionDesired(double cmd)
   {
     assert(pos_des_);
     *pos_des_ = cmd;
+    stamp();
   }
   void setVelocityDesired(double cmd)
   {
     assert(vel_des_);
     *vel_des_ = cmd;
+    stamp();
   }
   void setKp(double cmd)
   {
     assert(kp_);
     *kp_ = cmd;
+    stamp();
   }
   void setKd(double cmd)
   {
     assert(kd_);
     *kd_ = cmd;
+    stamp();
   }
   void setFeedforward(double cmd)
   {
     assert(ff_);
     *ff_ = cmd;
+    stamp();
   }
   void setCommand(double pos_des, double vel_des, double kp, double kd, double ff)
   {
@@ -101,11 +126,19 @@ public:
   }
 
 private:
+  void stamp()
+  {
+    if (cmd_generation_)
+      *cmd_generation_ = *generation_;
+  }
+
   double* pos_des_ = { nullptr };
   double* vel_des_ = { nullptr };
   double* kp_ = { nullptr };
   double* kd_ = { nullptr };
   double* ff_ = { nullptr };
+  const uint64_t* generation_ = { nullptr };
+  uint64_t* cmd_generation_ = { nullptr };
 };
 
 class HybridJointInterface
@@ -113,4 +146,105 @@ class HybridJointInterface
 {
 };
 
+/*!
+ * A contiguous block of hybrid joints, for the hardware which stores the joints as structure of arrays. Every pointer
+ * points to an array of size elements, so that a controller reads and writes all the joints with a few vector copies
+ * instead of size handles. The joints are also registered one by one in HybridJointInterface.
+ */
+class HybridJointBlockHandle
+{
+public:
+  HybridJointBlockHandle() = default;
+
+  HybridJointBlockHandle(const std::string& name, size_t size, const double* pos, const double* vel, const double* eff,
+                         double* pos_des, double* vel_des, double* kp, double* kd, double* ff,
+                         const uint64_t* generation = nullptr, uint64_t* cmd_generation = nullptr)
+    : name_(name)
+    , size_(size)
+    , pos_(pos)
+    , vel_(vel)
+    , eff_(eff)
+    , pos_des_(pos_des)
+    , vel_des_(vel_des)
+    , kp_(kp)
+    , kd_(kd)
+    , ff_(ff)
+    , generation_(generation)
+    , cmd_generation_(cmd_generation)
+  {
+    if (!pos_ || !vel_ || !eff_ || !pos_des_ || !vel_des_ || !kp_ || !kd_ || !ff_)
+    {
+      throw hardware_interface::HardwareInterfaceException("Cannot create handle '" + name +
+                                                           "'. A state or command data pointer is null.");
+    }
+    if ((generation_ == nullptr) != (cmd_generation_ == nullptr))
+    {
+      throw hardware_interface::HardwareInterfaceException("Cannot create handle '" + name +
+                                                           "'. Only one of the generation pointers is null.");
+    }
+  }
+
+  std::string getName() const
+  {
+    return name_;
+  }
+  size_t getSize() const
+  {
+    return size_;
+  }
+  const double* getPosition() const
+  {
+    return pos_;
+  }
+  const double* getVelocity() const
+  {
+    return vel_;
+  }
+  const double* getEffort() const
+  {
+    return eff_;
+  }
+
+  // Every argument points to size elements
+  void setCommands(const double* pos_des, const double* vel_des, const double* kp, const double* kd, const double* ff)
+  {
+    std::copy(pos_des, pos_des + size_, pos_des_);
+    std::copy(vel_des, vel_des + size_, vel_des_);
+    std::copy(kp, kp + size_, kp_);
+    std::copy(kd, kd + size_, kd_);
+    std::copy(ff, ff + size_, ff_);
+    stamp();
+  }
+  void setFeedforward(const double* ff)
+  {
+    std::copy(ff, ff + size_, ff_);
+    stamp();
+  }
+
+private:
+  void stamp()
+  {
+    if (cmd_generation_)
+      std::fill(cmd_generation_, cmd_generation_ + size_, *generation_);
+  }
+
+  std::string name_;
+  size_t size_{};
+  const double* pos_ = { nullptr };
+  const double* vel_ = { nullptr };
+  const double* eff_ = { nullptr };
+  double* pos_des_ = { nullptr };
+  double* vel_des_ = { nullptr };
+  double* kp_ = { nullptr };
+  double* kd_ = { nullptr };
+  double* ff_ = { nullptr };
+  const uint64_t* generation_ = { nullptr };
+  uint64_t* cmd_generation_ = { nullptr };  // Array of size elements
+};
+
+class HybridJointBlockInterface
+  : public hardware_interface::HardwareResourceManager<HybridJointBlockHandle, hardware_interface::DontClaimResources>
+{
+};
+
 }  // namespace cheetah_ros
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <cheetah_common/cpp_types.h>
+#include <cheetah_common/ros_utilities.h>
+
+namespace cheetah_ros
+{
+/*!
+ * Names of the legs of the robot, built once at init from the param /robot_legs and checked against the joints of the
+ * urdf. The joints are indexed leg by leg: joint j of leg l is l * getJointsPerLeg() + j, which is the order of the
+ * compact arrays of the hardware and of the controllers. Without the param, the legs are FL, FR, RL, RR of the unitree
+ * urdf. Name lookups are for init only, the real time paths keep the indices built from them.
+ *
+ * robot_legs:
+ *   legs: [ FL, FR, RL, RR ]                       # order of the legs in the controllers
+ *   joints: [ hip_joint, thigh_joint, calf_joint ] # "<leg>_<suffix>" is the joint in the urdf
+ *   foot: foot                                     # "<leg>_foot" is the frame of the foot
+ *   hip: hip                                       # "<leg>_hip" is the frame of the hip
+ *   FL: { joints: [ lf_haa, lf_hfe, lf_kfe ], foot: lf_foot, hip: lf_hip }  # full names of one leg, optional
+ */
+class RobotDescription
+{
+public:
+  /*!
+   * @param nh : any node handle, the param is global
+   * @param urdf_joints : names of the joints of the urdf, every joint of the legs should be one of them
+   * @return false if the param is malformed or a joint is not in the urdf
+   */
+  bool init(ros::NodeHandle& nh, const std::vector<std::string>& urdf_joints)
+  {
+    XmlRpc::XmlRpcValue params;
+    bool has_params = nh.getParam("/robot_legs", params);
+    if (has_params && params.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+    {
+      ROS_ERROR("/robot_legs should be a struct");
+      return false;
+    }
+
+    std::vector<std::string> suffixes{ "hip_joint", "thigh_joint", "calf_joint" };
+    std::string foot_suffix = "foot", hip_suffix = "hip";
+    legs_.assign(LEG_PREFIX, LEG_PREFIX + 4);
+    if (has_params)
+    {
+      if (params.hasMember("legs") && !getStrings(params["legs"], legs_))
+        return false;
+      if (params.hasMember("joints") && !getStrings(params["joints"], suffixes))
+        return false;
+      if (params.hasMember("foot"))
+        foot_suffix = static_cast<std::string>(params["foot"]);
+      if (params.hasMember("hip"))
+        hip_suffix = static_cast<std::string>(params["hip"]);
+    }
+    if (legs_.empty() || suffixes.empty())
+    {
+      ROS_ERROR("/robot_legs has no leg or no joint");
+      return false;
+    }
+    joints_per_leg_ = static_cast<int>(suffixes.size());
+
+    joints_.clear();
+    feet_.clear();
+    hips_.clear();
+    for (const auto& leg : legs_)
+    {
+      std::vector<std::string> joints;
+      for (const auto& suffix : suffixes)
+        joints.push_back(leg + "_" + suffix);
+      std::string foot = leg + "_" + foot_suffix, hip = leg + "_" + hip_suffix;
+      if (has_params && params.hasMember(leg))
+      {
+        XmlRpc::XmlRpcValue& leg_params = params[leg];
+        if (leg_params.hasMember("joints") && !getStrings(leg_params["joints"], joints))
+          return false;
+        if (leg_params.hasMember("foot"))
+          foot = static_cast<std::string>(leg_params["foot"]);
+        if (leg_params.hasMember("hip"))
+          hip = static_cast<std::string>(leg_params["hip"]);
+      }
+      if (static_cast<int>(joints.size()) != joints_per_leg_)
+      {
+        ROS_ERROR_STREAM("The leg " << leg << " has " << joints.size() << " joints instead of " << joints_per_leg_);
+        return false;
+      }
+      for (const auto& joint : joints)
+        if (std::find(urdf_joints.begin(), urdf_joints.end(), joint) == urdf_joints.end())
+        {
+          ROS_ERROR_STREAM("Can not find the joint " << joint << " of the leg " << leg << " in the urdf");
+          return false;
+        }
+      joints_.insert(joints_.end(), joints.begin(), joints.end());
+      feet_.push_back(foot);
+      hips_.push_back(hip);
+    }
+    return true;
+  }
+
+  int getNumLegs() const
+  {
+    return static_cast<int>(legs_.size());
+  }
+
+  int getJointsPerLeg() const
+  {
+    return joints_per_leg_;
+  }
+
+  int getNumJoints() const
+  {
+    return static_cast<int>(joints_.size());
+  }
+
+  const std::string& getLegName(int leg) const
+  {
+    return legs_[leg];
+  }
+
+  // Index l * getJointsPerLeg() + j
+  const std::string& getJointName(int index) const
+  {
+    return joints_[index];
+  }
+
+  const std::string& getFootName(int leg) const
+  {
+    return feet_[leg];
+  }
+
+  const std::string& getHipName(int leg) const
+  {
+    return hips_[leg];
+  }
+
+private:
+  static bool getStrings(XmlRpc::XmlRpcValue& value, std::vector<std::string>& strings)
+  {
+    if (value.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+      ROS_ERROR("Expect a list of names in /robot_legs");
+      return false;
+    }
+    strings.clear();
+    for (int i = 0; i < value.size(); ++i)
+      strings.push_back(static_cast<std::string>(value[i]));
+    return true;
+  }
+
+  std::vector<std::string> legs_, joints_, feet_, hips_;
+  int joints_per_leg_{};
+};
+
+}  // namespace cheetah_ros
@@ -37,6 +37,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
 #include <ros/ros.h>
 #include <XmlRpcException.h>
 
@@ -78,3 +83,22 @@ inline double xmlRpcGetDouble(XmlRpc::XmlRpcValue& value, const std::string& fie
   else
     return default_value;
 }
+
+// Capacity to reserve for the strings of a message which is filled in a realtime loop, e.g. the values of diagnostics
+const size_t REALTIME_STRING_CAPACITY = 64;
+
+/*!
+ * Format a number in place without allocation, unlike std::to_string, for the messages filled in a realtime loop.
+ * The string should have REALTIME_STRING_CAPACITY reserved at init.
+ */
+template <typename T>
+void formatNumber(std::string& str, T value)
+{
+  char buffer[32];
+  int length;
+  if (std::is_integral<T>::value)
+    length = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+  else
+    length = std::snprintf(buffer, sizeof(buffer), "%g", static_cast<double>(value));
+  str.assign(buffer, std::min(std::max(length, 0), static_cast<int>(sizeof(buffer)) - 1));
+}
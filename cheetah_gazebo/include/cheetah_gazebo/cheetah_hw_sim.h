@@ -37,7 +37,8 @@
 
 #pragma once
 
-#include <deque>
+#include <random>
+#include <vector>
 
 #include <gazebo_ros_control/default_robot_hw_sim.h>
 #include <hardware_interface/imu_sensor_interface.h>
@@ -45,19 +46,123 @@
 
 #include <cheetah_common/hardware_interface/hybrid_joint_interface.h>
 #include <cheetah_common/hardware_interface/contact_sensor_interface.h>
+#include <cheetah_common/robot_description.h>
 
 namespace cheetah_ros
 {
+struct HybridJointCommand
+{
+  double pos_des_, vel_des_, kp_, kd_, ff_;
+};
+
+/*!
+ * Fixed capacity ring buffer which delays the commands by a constant number of ticks, no allocation after construction.
+ */
+template <typename T>
+class DelayBuffer
+{
+public:
+  explicit DelayBuffer(size_t delay_steps = 0) : data_(delay_steps + 1, T{}), head_(0)
+  {
+  }
+  // Push the newest element and return the one pushed delay_steps ticks ago (zero initialized at the start)
+  const T& push(const T& value)
+  {
+    data_[head_] = value;
+    head_ = head_ + 1 == data_.size() ? 0 : head_ + 1;
+    return data_[head_];
+  }
+
+private:
+  std::vector<T> data_;
+  size_t head_;
+};
+
+/*!
+ * Delays the readings of a sensor by a constant time, whatever the period they are pushed at. Sized for one reading per
+ * physics step, the shortest period possible, no allocation after construction.
+ */
+template <typename T>
+class LatencyBuffer
+{
+public:
+  explicit LatencyBuffer(double latency = 0., double dt = 1.)
+    : latency_(latency - dt / 2.), data_(std::max(std::lround(latency / dt), 0L) + 1), head_(0)
+  {
+  }
+  // Push the newest reading and return the newest one which is at least latency old (default initialized at the start)
+  const T& push(const ros::Time& time, const T& value)
+  {
+    data_[head_] = Stamped{ time, value, true };
+    size_t i = head_;
+    head_ = head_ + 1 == data_.size() ? 0 : head_ + 1;
+    for (size_t n = 0; n < data_.size(); ++n)
+    {
+      if (data_[i].valid_ && (time - data_[i].stamp_).toSec() >= latency_)
+        return data_[i].value_;
+      i = i == 0 ? data_.size() - 1 : i - 1;
+    }
+    return initial_;
+  }
+
+private:
+  struct Stamped
+  {
+    ros::Time stamp_;
+    T value_;
+    bool valid_;
+  };
+  double latency_;  // Less half a physics step, against the rounding of the times
+  std::vector<Stamped> data_;
+  size_t head_;
+  T initial_{};
+};
+
+/*!
+ * First order bandwidth limit of the torque and a linear torque-speed curve: the torque which accelerates the joint is
+ * limited by max_torque * (1 - |vel| / max_velocity), braking torque is limited by max_torque only.
+ */
+struct MotorModel
+{
+  bool enable_;
+  double bandwidth_, max_torque_, max_velocity_;  // Hz, N*m, rad/s
+
+  double update(double& tau_state, double tau_cmd, double vel, double dt) const
+  {
+    tau_state += dt / (dt + 1. / (2. * M_PI * bandwidth_)) * (tau_cmd - tau_state);
+    double limit = max_torque_;
+    if (tau_state * vel > 0.)
+      limit *= std::max(1. - std::abs(vel) / max_velocity_, 0.);
+    return std::min(std::max(tau_state, -limit), limit);
+  }
+};
+
 struct HybridJointData
 {
   hardware_interface::JointHandle joint_;
   double pos_des_, vel_des_, kp_, kd_, ff_;
+  DelayBuffer<HybridJointCommand> cmd_buffer_;
+  double tau_;    // State of the motor model
+  size_t index_;  // Index in the joint arrays of DefaultRobotHWSim
 };
 
-struct HybridJointCommand
+struct ImuReading
 {
-  ros::Time stamp_;
-  double pos_des_, vel_des_, kp_, kd_, ff_;
+  double ori[4]{ 0., 0., 0., 1. };
+  double angular_vel[3]{};
+  double linear_acc[3]{};
+};
+
+/*!
+ * White noise with the standard deviation of the covariance diagonals, random walk of the gyroscope and accelerometer
+ * biases, and a latency.
+ */
+struct ImuNoise
+{
+  bool enable_;
+  double gyro_bias_walk_, acc_bias_walk_;  // Standard deviation per sqrt(s)
+  double gyro_bias_[3], acc_bias_[3];
+  LatencyBuffer<ImuReading> buffer_;
 };
 
 struct ImuData
@@ -69,6 +174,19 @@ struct ImuData
   double angular_vel_cov[9];
   double linear_acc[3];
   double linear_acc_cov[9];
+  ImuNoise noise_;
+};
+
+struct EncoderReading
+{
+  double pos_, vel_;
+};
+
+struct EncoderNoise
+{
+  bool enable_;
+  double position_stddev_, velocity_stddev_;
+  std::vector<LatencyBuffer<EncoderReading>> buffers_;
 };
 
 class CheetahHWSim : public gazebo_ros_control::DefaultRobotHWSim
@@ -82,18 +200,30 @@ public:
 
 private:
   void parseImu(XmlRpc::XmlRpcValue& imu_datas, const gazebo::physics::ModelPtr& parent_model);
+  void updateContact(const ros::Time& time, const ros::Duration& period);
+  void updateImu(ImuData& imu, const ros::Time& time, const ros::Duration& period);
 
   HybridJointInterface hybrid_joint_interface_;
   ContactSensorInterface contact_sensor_interface_;
   hardware_interface::ImuSensorInterface imu_sensor_interface_;
 
   gazebo::physics::ContactManager* contact_manager_;
+  RobotDescription robot_description_;
+  // Collisions of the feet resolved in initSim, map to the index of leg
+  std::unordered_map<const gazebo::physics::Collision*, int> foot_collisions_;
 
   std::list<HybridJointData> hybrid_joint_datas_;
   std::list<ImuData> imu_datas_;
-  std::unordered_map<std::string, std::deque<HybridJointCommand> > cmd_buffer_;
   double delay_;
+  MotorModel motor_model_;
+  // Sensor model
+  EncoderNoise encoder_noise_;
+  std::mt19937 random_engine_;
+  std::normal_distribution<double> normal_;
   bool contact_state_[4];
+  ignition::math::Vector3d contact_force_[4];  // Force applied on the feet by the environment, in world frame
+  // What the contact sensor interface exposes, the probability is certain in simulation
+  double contact_probability_[4], contact_normal_force_[4];
 };
 
 }  // namespace cheetah_ros
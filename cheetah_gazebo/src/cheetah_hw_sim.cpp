@@ -38,6 +38,7 @@
 #include "cheetah_gazebo/cheetah_hw_sim.h"
 #include <gazebo_ros_control/gazebo_ros_control_plugin.h>
 #include <cheetah_common/cpp_types.h>
+#include <cheetah_common/ros_utilities.h>
 
 namespace cheetah_ros
 {
@@ -46,17 +47,50 @@ bool CheetahHWSim::initSim(const std::string& robot_namespace, ros::NodeHandle m
                            std::vector<transmission_interface::TransmissionInfo> transmissions)
 {
   bool ret = DefaultRobotHWSim::initSim(robot_namespace, model_nh, parent_model, urdf_model, transmissions);
+  if (!model_nh.getParam("gazebo/delay", delay_))
+    delay_ = 0.;
+  // The commands are delayed by whole ticks of the physics in writeSim, which runs at every step. The sensors are read
+  // at the control period, which can be longer, so their latency is kept in time instead.
+  double dt = parent_model->GetWorld()->Physics()->GetMaxStepSize();
+  auto delay_steps = static_cast<size_t>(std::max(std::lround(delay_ / dt), 0L));
+  random_engine_.seed(getParam(model_nh, "gazebo/noise_seed", 0));
+  XmlRpc::XmlRpcValue encoder;
+  encoder_noise_.enable_ = model_nh.getParam("gazebo/encoder", encoder);
+  if (encoder_noise_.enable_)
+  {
+    encoder_noise_.position_stddev_ = xmlRpcGetDouble(encoder, "position_stddev", 0.);
+    encoder_noise_.velocity_stddev_ = xmlRpcGetDouble(encoder, "velocity_stddev", 0.);
+    encoder_noise_.buffers_.resize(n_dof_,
+                                   LatencyBuffer<EncoderReading>(xmlRpcGetDouble(encoder, "latency", 0.), dt));
+  }
+  XmlRpc::XmlRpcValue motor;
+  if (model_nh.getParam("gazebo/motor", motor))
+    motor_model_ = MotorModel{ .enable_ = true,
+                               .bandwidth_ = xmlRpcGetDouble(motor, "bandwidth", 1e3),
+                               .max_torque_ = xmlRpcGetDouble(motor, "max_torque", 1e3),
+                               .max_velocity_ = xmlRpcGetDouble(motor, "max_velocity", 1e3) };
+  else
+    motor_model_.enable_ = false;
+
   // Joint interface
   registerInterface(&hybrid_joint_interface_);
   std::vector<std::string> names = ej_interface_.getNames();
   for (const auto& name : names)
   {
-    hybrid_joint_datas_.push_back(HybridJointData{ .joint_ = ej_interface_.getHandle(name) });
+    hybrid_joint_datas_.push_back(HybridJointData{ .joint_ = ej_interface_.getHandle(name),
+                                                   .pos_des_ = 0.,
+                                                   .vel_des_ = 0.,
+                                                   .kp_ = 0.,
+                                                   .kd_ = 0.,
+                                                   .ff_ = 0.,
+                                                   .cmd_buffer_ = DelayBuffer<HybridJointCommand>(delay_steps),
+                                                   .tau_ = 0.,
+                                                   .index_ = static_cast<size_t>(
+                                                       std::find(joint_names_.begin(), joint_names_.end(), name) -
+                                                       joint_names_.begin()) });
     HybridJointData& back = hybrid_joint_datas_.back();
     hybrid_joint_interface_.registerHandle(
         HybridJointHandle(back.joint_, &back.pos_des_, &back.vel_des_, &back.kp_, &back.kd_, &back.ff_));
-    cmd_buffer_.insert(
-        std::make_pair<std::string, std::deque<HybridJointCommand>>(name.c_str(), std::deque<HybridJointCommand>()));
   }
   // IMU interface
   registerInterface(&imu_sensor_interface_);
@@ -65,84 +99,154 @@ bool CheetahHWSim::initSim(const std::string& robot_namespace, ros::NodeHandle m
     ROS_WARN("No imu specified");
   else
     parseImu(xml_rpc_value, parent_model);
-  if (!model_nh.getParam("gazebo/delay", delay_))
-    delay_ = 0.;
 
   // Contact Sensor interface
-  contact_sensor_interface_.registerHandle(ContactSensorHandle("feet", contact_state_));
+  contact_sensor_interface_.registerHandle(
+      ContactSensorHandle("feet", contact_state_, contact_probability_, contact_normal_force_));
   registerInterface(&contact_sensor_interface_);
   contact_manager_ = parent_model->GetWorld()->Physics()->GetContactManager();
   contact_manager_->SetNeverDropContacts(true);  // NOTE: If false, we need to select view->contacts in gazebo GUI to
                                                  // avoid returning nothing when calling ContactManager::GetContacts()
+  std::vector<std::string> urdf_joints;
+  for (const auto& joint : urdf_model->joints_)
+    urdf_joints.push_back(joint.first);
+  if (!robot_description_.init(model_nh, urdf_joints) || robot_description_.getNumLegs() != 4)
+  {
+    ROS_ERROR("Expect 4 legs in /robot_legs");
+    return false;
+  }
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    // Gazebo lumps a link attached by fixed joints into its parent, the collisions keep the name of the link, e.g.
+    // FR_calf_fixed_joint_lump__FR_foot_collision_1
+    const std::string& foot = robot_description_.getFootName(leg);
+    urdf::LinkConstSharedPtr urdf_link = urdf_model->getLink(foot);
+    while (urdf_link != nullptr && urdf_link->parent_joint != nullptr &&
+           urdf_link->parent_joint->type == urdf::Joint::FIXED && parent_model->GetLink(urdf_link->name) == nullptr)
+      urdf_link = urdf_link->getParent();
+    gazebo::physics::LinkPtr link = urdf_link == nullptr ? nullptr : parent_model->GetLink(urdf_link->name);
+    int num_collisions = 0;
+    if (link != nullptr)
+      for (const auto& collision : link->GetCollisions())
+        if (link->GetName() == foot || collision->GetName().find(foot + "_collision") != std::string::npos)
+        {
+          foot_collisions_[collision.get()] = leg;
+          num_collisions++;
+        }
+    if (num_collisions == 0)
+    {
+      ROS_ERROR_STREAM("Can not find the collision of the foot " << foot << ", the contact can not be sensed.");
+      return false;
+    }
+  }
   return ret;
 }
 
 void CheetahHWSim::readSim(ros::Time time, ros::Duration period)
 {
   gazebo_ros_control::DefaultRobotHWSim::readSim(time, period);
+  for (size_t i = 0; i < n_dof_ && encoder_noise_.enable_; ++i)
+  {
+    const EncoderReading& reading = encoder_noise_.buffers_[i].push(
+        time, EncoderReading{ .pos_ = joint_position_[i] + encoder_noise_.position_stddev_ * normal_(random_engine_),
+                              .vel_ = joint_velocity_[i] + encoder_noise_.velocity_stddev_ * normal_(random_engine_) });
+    joint_position_[i] = reading.pos_;
+    joint_velocity_[i] = reading.vel_;
+  }
   for (auto& imu : imu_datas_)
+    updateImu(imu, time, period);
+
+  updateContact(time, period);
+
+  // Set cmd to zero to avoid crazy soft limit oscillation when not controller loaded
+  for (auto& cmd : joint_effort_command_)
+    cmd = 0;
+  for (auto& cmd : joint_velocity_command_)
+    cmd = 0;
+}
+
+void CheetahHWSim::updateImu(ImuData& imu, const ros::Time& time, const ros::Duration& period)
+{
+  ignition::math::Pose3d pose = imu.link_prt->WorldPose();
+  ignition::math::Quaterniond ori = pose.Rot();
+  ignition::math::Vector3d rate = imu.link_prt->RelativeAngularVel();
+  ignition::math::Vector3d gravity = { 0., 0., -9.81 };
+  ignition::math::Vector3d accel = imu.link_prt->RelativeLinearAccel() - pose.Rot().RotateVectorReverse(gravity);
+
+  ImuNoise& noise = imu.noise_;
+  if (noise.enable_)
   {
-    // TODO(qiayuan) Add noise
-    ignition::math::Pose3d pose = imu.link_prt->WorldPose();
-    imu.ori[0] = pose.Rot().X();
-    imu.ori[1] = pose.Rot().Y();
-    imu.ori[2] = pose.Rot().Z();
-    imu.ori[3] = pose.Rot().W();
-    ignition::math::Vector3d rate = imu.link_prt->RelativeAngularVel();
-    imu.angular_vel[0] = rate.X();
-    imu.angular_vel[1] = rate.Y();
-    imu.angular_vel[2] = rate.Z();
-
-    ignition::math::Vector3d gravity = { 0., 0., -9.81 };
-    ignition::math::Vector3d accel = imu.link_prt->RelativeLinearAccel() - pose.Rot().RotateVectorReverse(gravity);
-    imu.linear_acc[0] = accel.X();
-    imu.linear_acc[1] = accel.Y();
-    imu.linear_acc[2] = accel.Z();
+    double sqrt_dt = std::sqrt(period.toSec());
+    ignition::math::Vector3d ori_noise;
+    for (int i = 0; i < 3; ++i)
+    {
+      noise.gyro_bias_[i] += noise.gyro_bias_walk_ * sqrt_dt * normal_(random_engine_);
+      noise.acc_bias_[i] += noise.acc_bias_walk_ * sqrt_dt * normal_(random_engine_);
+      ori_noise[i] = std::sqrt(imu.ori_cov[4 * i]) * normal_(random_engine_);
+      rate[i] += noise.gyro_bias_[i] + std::sqrt(imu.angular_vel_cov[4 * i]) * normal_(random_engine_);
+      accel[i] += noise.acc_bias_[i] + std::sqrt(imu.linear_acc_cov[4 * i]) * normal_(random_engine_);
+    }
+    ori = ori * ignition::math::Quaterniond(ori_noise);  // Small rotation in the imu frame
   }
 
-  for (bool& state : contact_state_)
-    state = false;
+  const ImuReading& reading =
+      noise.buffer_.push(time, ImuReading{ .ori = { ori.X(), ori.Y(), ori.Z(), ori.W() },
+                                           .angular_vel = { rate.X(), rate.Y(), rate.Z() },
+                                           .linear_acc = { accel.X(), accel.Y(), accel.Z() } });
+  std::copy(reading.ori, reading.ori + 4, imu.ori);
+  std::copy(reading.angular_vel, reading.angular_vel + 3, imu.angular_vel);
+  std::copy(reading.linear_acc, reading.linear_acc + 3, imu.linear_acc);
+}
+
+void CheetahHWSim::updateContact(const ros::Time& time, const ros::Duration& period)
+{
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    contact_state_[leg] = false;
+    contact_force_[leg] = ignition::math::Vector3d::Zero;
+  }
+  // Only compare the collision pointers, the contacts of the other models are skipped at the cost of two lookups
   for (const auto& contact : contact_manager_->GetContacts())
   {
     if (static_cast<uint32_t>(contact->time.sec) != time.sec ||
         static_cast<uint32_t>(contact->time.nsec) != (time - period).nsec)
       continue;
-    std::string link_name;
-    if (contact->collision1->GetLink()->GetName().find("foot") != std::string::npos)
-      link_name = contact->collision1->GetLink()->GetName();
-    else if (contact->collision2->GetLink()->GetName().find("foot") != std::string::npos)
-      link_name = contact->collision2->GetLink()->GetName();
-    else
-      continue;
-    for (int i = 0; i < 4; ++i)
-      if (link_name.find(LEG_PREFIX[i]) != std::string::npos)
-        contact_state_[i] = true;
+    auto it = foot_collisions_.find(contact->collision1);
+    bool is_body1 = it != foot_collisions_.end();
+    if (!is_body1)
+    {
+      it = foot_collisions_.find(contact->collision2);
+      if (it == foot_collisions_.end())
+        continue;
+    }
+    int leg = it->second;
+    contact_state_[leg] = true;
+    // The wrench is expressed in the frame of the link which the collision belongs to
+    ignition::math::Quaterniond rot = it->first->GetLink()->WorldPose().Rot();
+    for (int i = 0; i < contact->count; ++i)
+      contact_force_[leg] +=
+          rot.RotateVector(is_body1 ? contact->wrench[i].body1Force : contact->wrench[i].body2Force);
+  }
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    contact_probability_[leg] = contact_state_[leg] ? 1. : 0.;
+    contact_normal_force_[leg] = contact_force_[leg].Z();  // Flat ground
   }
-
-  // Set cmd to zero to avoid crazy soft limit oscillation when not controller loaded
-  for (auto& cmd : joint_effort_command_)
-    cmd = 0;
-  for (auto& cmd : joint_velocity_command_)
-    cmd = 0;
 }
 
 void CheetahHWSim::writeSim(ros::Time time, ros::Duration period)
 {
-  for (auto joint : hybrid_joint_datas_)
+  for (auto& joint : hybrid_joint_datas_)
   {
-    auto& buffer = cmd_buffer_.find(joint.joint_.getName())->second;
-    buffer.push_front(HybridJointCommand{ .stamp_ = time,
-                                          .pos_des_ = joint.pos_des_,
-                                          .vel_des_ = joint.vel_des_,
-                                          .kp_ = joint.kp_,
-                                          .kd_ = joint.kd_,
-                                          .ff_ = joint.ff_ });
-
-    while (!buffer.empty() && buffer.back().stamp_ + ros::Duration(delay_) < time)
-      buffer.pop_back();
-    const auto& cmd = buffer.back();
-    joint.joint_.setCommand(cmd.kp_ * (cmd.pos_des_ - joint.joint_.getPosition()) +
-                            cmd.kd_ * (cmd.vel_des_ - joint.joint_.getVelocity()) + cmd.ff_);
+    const HybridJointCommand& cmd = joint.cmd_buffer_.push(HybridJointCommand{
+        .pos_des_ = joint.pos_des_, .vel_des_ = joint.vel_des_, .kp_ = joint.kp_, .kd_ = joint.kd_, .ff_ = joint.ff_ });
+    // The PD runs on the motor driver at every physics step, on the true state of the joint without latency
+    const gazebo::physics::JointPtr& sim_joint = sim_joints_[joint.index_];
+    double pos = sim_joint->Position(0), vel = sim_joint->GetVelocity(0);
+    double tau = cmd.kp_ * (cmd.pos_des_ - pos) + cmd.kd_ * (cmd.vel_des_ - vel) + cmd.ff_;
+    if (motor_model_.enable_)
+      tau = motor_model_.update(joint.tau_, tau, vel, period.toSec());
+    joint.joint_.setCommand(tau);
   }
   DefaultRobotHWSim::writeSim(time, period);
 }
@@ -177,7 +281,7 @@ void CheetahHWSim::parseImu(XmlRpc::XmlRpcValue& imu_datas, const gazebo::physic
     ROS_ASSERT(ori_cov.size() == 3);
     for (int i = 0; i < ori_cov.size(); ++i)
       ROS_ASSERT(ori_cov[i].getType() == XmlRpc::XmlRpcValue::TypeDouble);
-    XmlRpc::XmlRpcValue angular_cov = imu_datas[it->first]["orientation_covariance_diagonal"];
+    XmlRpc::XmlRpcValue angular_cov = imu_datas[it->first]["angular_velocity_covariance"];
     ROS_ASSERT(angular_cov.getType() == XmlRpc::XmlRpcValue::TypeArray);
     ROS_ASSERT(angular_cov.size() == 3);
     for (int i = 0; i < angular_cov.size(); ++i)
@@ -203,6 +307,14 @@ void CheetahHWSim::parseImu(XmlRpc::XmlRpcValue& imu_datas, const gazebo::physic
         .linear_acc_cov = { static_cast<double>(linear_cov[0]), 0., 0., 0., static_cast<double>(linear_cov[1]), 0., 0.,
                             0., static_cast<double>(linear_cov[2]) } }));
     ImuData& imu_data = imu_datas_.back();
+    double dt = parent_model->GetWorld()->Physics()->GetMaxStepSize();
+    bool add_noise = it->second.hasMember("add_noise") && static_cast<bool>(it->second["add_noise"]);
+    imu_data.noise_ = ImuNoise{ .enable_ = add_noise,
+                                .gyro_bias_walk_ = xmlRpcGetDouble(it->second, "gyro_bias_walk", 0.),
+                                .acc_bias_walk_ = xmlRpcGetDouble(it->second, "acc_bias_walk", 0.),
+                                .gyro_bias_ = { 0., 0., 0. },
+                                .acc_bias_ = { 0., 0., 0. },
+                                .buffer_ = LatencyBuffer<ImuReading>(xmlRpcGetDouble(it->second, "latency", 0.), dt) };
     imu_sensor_interface_.registerHandle(
         hardware_interface::ImuSensorHandle(it->first, frame_id, imu_data.ori, imu_data.ori_cov, imu_data.angular_vel,
                                             imu_data.angular_vel_cov, imu_data.linear_acc, imu_data.linear_acc_cov));
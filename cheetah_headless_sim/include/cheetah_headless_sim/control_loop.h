@@ -0,0 +1,39 @@
+#pragma once
+
+#include "headless_hw.h"
+
+#include <chrono>
+#include <utility>
+
+#include <ros/ros.h>
+#include <controller_manager/controller_manager.h>
+
+namespace cheetah_ros
+{
+using namespace std::chrono;
+
+/*!
+ * Drive HeadlessHW by the simulated time instead of a timer: every tick calls read, controller manager and write, then
+ * integrates the physics by several sub steps and publishes the new time on /clock (run with /use_sim_time).
+ */
+class HeadlessHWLoop
+{
+public:
+  HeadlessHWLoop(ros::NodeHandle& nh, std::shared_ptr<HeadlessHW> hardware_interface);
+  // Block until ros shutdown
+  void run();
+
+private:
+  ros::NodeHandle nh_;
+
+  // Settings
+  double loop_hz_{};
+  double physics_dt_{};
+  double real_time_factor_{};  // Zero to run as fast as possible
+
+  ros::Publisher clock_pub_;
+
+  std::shared_ptr<controller_manager::ControllerManager> controller_manager_;
+  std::shared_ptr<HeadlessHW> hardware_interface_;
+};
+}  // namespace cheetah_ros
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <pinocchio/fwd.hpp>
+#include <pinocchio/multibody/model.hpp>
+#include <pinocchio/multibody/data.hpp>
+
+#include <ros/ros.h>
+#include <hardware_interface/robot_hw.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/imu_sensor_interface.h>
+#include <cheetah_common/hardware_interface/hybrid_joint_interface.h>
+#include <cheetah_common/hardware_interface/contact_sensor_interface.h>
+#include <cheetah_common/cpp_types.h>
+#include <cheetah_common/robot_description.h>
+#include <realtime_tools/realtime_publisher.h>
+#include <nav_msgs/Odometry.h>
+
+namespace cheetah_ros
+{
+struct HeadlessJointData
+{
+  double pos_, vel_, tau_;                   // state
+  double pos_des_, vel_des_, kp_, kd_, ff_;  // command
+};
+
+struct HeadlessImuData
+{
+  double ori[4];
+  double ori_cov[9];
+  double angular_vel[3];
+  double angular_vel_cov[9];
+  double linear_acc[3];
+  double linear_acc_cov[9];
+};
+
+/*!
+ * A RobotHW without gazebo: the floating base dynamics of the urdf are integrated by pinocchio (ABA) and the feet touch
+ * a flat ground through a spring-damper with a friction limit. It exposes the same interfaces as CheetahHWSim and
+ * UnitreeHW, so the controllers run unchanged, and the time is driven by HeadlessHWLoop.
+ */
+class HeadlessHW : public hardware_interface::RobotHW
+{
+public:
+  HeadlessHW() = default;
+  bool init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh) override;
+  void read(const ros::Time& time, const ros::Duration& period) override;
+  // Latch the command, which is tracked by the joint PD of step() until the next write()
+  void write(const ros::Time& time, const ros::Duration& period) override;
+  // Integrate the physics by dt (semi-implicit euler)
+  void step(double dt);
+
+private:
+  void updateContact();
+  void publishGroundTruth(const ros::Time& time);
+
+  std::shared_ptr<pinocchio::Model> pin_model_;
+  std::shared_ptr<pinocchio::Data> pin_data_;
+  Eigen::VectorXd q_, v_, tau_;
+  pinocchio::container::aligned_vector<pinocchio::Force> fext_;
+  RobotDescription robot_description_;
+  pinocchio::FrameIndex foot_frame_ids_[4];
+
+  // Contact model
+  double stiffness_, damping_, tangential_damping_, mu_, foot_radius_;
+
+  HeadlessJointData joint_data_[12]{};
+  HeadlessJointData joint_cmd_[12]{};
+  HeadlessImuData imu_data_{};
+  bool contact_state_[4]{};
+  double contact_probability_[4]{}, contact_force_[4]{};
+
+  // Interface
+  hardware_interface::JointStateInterface joint_state_interface_;
+  hardware_interface::ImuSensorInterface imu_sensor_interface_;
+  HybridJointInterface hybrid_joint_interface_;
+  ContactSensorInterface contact_sensor_interface_;
+
+  std::shared_ptr<realtime_tools::RealtimePublisher<nav_msgs::Odometry>> ground_truth_pub_;
+};
+
+}  // namespace cheetah_ros
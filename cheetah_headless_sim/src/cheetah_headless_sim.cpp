@@ -0,0 +1,29 @@
+#include "cheetah_headless_sim/control_loop.h"
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "headless_sim");
+  ros::NodeHandle nh;
+  ros::NodeHandle robot_hw_nh("~");
+
+  // Service callbacks (e.g. loading controllers) are handled in separate threads, the main thread runs the simulation
+  ros::AsyncSpinner spinner(2);
+  spinner.start();
+
+  try
+  {
+    std::shared_ptr<cheetah_ros::HeadlessHW> headless_hw = std::make_shared<cheetah_ros::HeadlessHW>();
+    if (!headless_hw->init(nh, robot_hw_nh))
+      return 1;
+    cheetah_ros::HeadlessHWLoop control_loop(nh, headless_hw);
+    control_loop.run();
+  }
+  catch (const ros::Exception& e)
+  {
+    ROS_FATAL_STREAM("Error in the headless simulation:\n"
+                     << "\t" << e.what());
+    return 1;
+  }
+
+  return 0;
+}
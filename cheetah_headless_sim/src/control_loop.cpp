@@ -0,0 +1,55 @@
+#include "cheetah_headless_sim/control_loop.h"
+
+#include <cheetah_common/ros_utilities.h>
+#include <rosgraph_msgs/Clock.h>
+
+#include <thread>
+
+namespace cheetah_ros
+{
+HeadlessHWLoop::HeadlessHWLoop(ros::NodeHandle& nh, std::shared_ptr<HeadlessHW> hardware_interface)
+  : nh_(nh), hardware_interface_(std::move(hardware_interface))
+{
+  controller_manager_.reset(new controller_manager::ControllerManager(hardware_interface_.get(), nh_));
+
+  ros::NodeHandle nh_p("~");
+  loop_hz_ = getParam(nh_p, "loop_frequency", 1000.);
+  physics_dt_ = getParam(nh_p, "physics_dt", 0.0005);
+  real_time_factor_ = getParam(nh_p, "real_time_factor", 1.);
+  if (loop_hz_ <= 0. || physics_dt_ <= 0.)
+  {
+    char error_message[] = "headless_sim/loop_frequency and headless_sim/physics_dt should be positive";
+    ROS_ERROR_STREAM(error_message);
+    throw std::runtime_error(error_message);
+  }
+  clock_pub_ = nh_.advertise<rosgraph_msgs::Clock>("/clock", 10);
+}
+
+void HeadlessHWLoop::run()
+{
+  const ros::Duration period(1. / loop_hz_);
+  const int sub_steps = std::max(static_cast<int>(std::round(period.toSec() / physics_dt_)), 1);
+  // Zero time means "not received yet" for the nodes using /use_sim_time
+  ros::Time time(period.toSec());
+  rosgraph_msgs::Clock clock;
+  steady_clock::time_point start = steady_clock::now();
+
+  while (ros::ok())
+  {
+    clock.clock = time;
+    clock_pub_.publish(clock);
+
+    hardware_interface_->read(time, period);
+    controller_manager_->update(time, period);
+    hardware_interface_->write(time, period);
+    for (int i = 0; i < sub_steps; ++i)
+      hardware_interface_->step(period.toSec() / sub_steps);
+    time += period;
+
+    if (real_time_factor_ > 0.)
+      std::this_thread::sleep_until(start + duration_cast<steady_clock::duration>(
+                                                duration<double>(time.toSec() / real_time_factor_)));
+  }
+}
+
+}  // namespace cheetah_ros
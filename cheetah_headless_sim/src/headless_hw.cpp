@@ -0,0 +1,214 @@
+#include "cheetah_headless_sim/headless_hw.h"
+
+#include <pinocchio/parsers/urdf.hpp>
+#include <pinocchio/algorithm/joint-configuration.hpp>
+#include <pinocchio/algorithm/kinematics.hpp>
+#include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/aba.hpp>
+
+#include <cheetah_common/ros_utilities.h>
+
+namespace cheetah_ros
+{
+bool HeadlessHW::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh)
+{
+  std::string urdf_string;
+  root_nh.getParam("/robot_description", urdf_string);
+  if (urdf_string.empty())
+  {
+    ROS_ERROR("Error occurred while setting up urdf");
+    return false;
+  }
+  pin_model_ = std::make_shared<pinocchio::Model>();
+  pinocchio::urdf::buildModelFromXML(urdf_string, pinocchio::JointModelFreeFlyer(), *pin_model_);
+  pin_data_ = std::make_shared<pinocchio::Data>(*pin_model_);
+  if (pin_model_->nv != 18)
+  {
+    ROS_ERROR_STREAM("Expect a quadruped with 12 joints, but the urdf has " << pin_model_->nv - 6);
+    return false;
+  }
+
+  // Initial pose: standing height over the ground with the nominal joint positions
+  q_ = pinocchio::neutral(*pin_model_);
+  v_ = Eigen::VectorXd::Zero(pin_model_->nv);
+  tau_ = Eigen::VectorXd::Zero(pin_model_->nv);
+  fext_.resize(pin_model_->njoints, pinocchio::Force::Zero());
+  if (!robot_description_.init(robot_hw_nh, pin_model_->names))
+    return false;
+  if (robot_description_.getNumLegs() != 4 || robot_description_.getJointsPerLeg() != 3)
+  {
+    ROS_ERROR("Expect 4 legs of 3 joints, check /robot_legs");
+    return false;
+  }
+  q_(2) = getParam(robot_hw_nh, "initial_height", 0.5);
+  XmlRpc::XmlRpcValue joint_pos;
+  if (robot_hw_nh.getParam("initial_joint_pos", joint_pos) && joint_pos.size() == 3)
+    for (int i = 0; i < 12; ++i)
+    {
+      pinocchio::JointIndex joint_id = pin_model_->getJointId(robot_description_.getJointName(i));
+      q_(pin_model_->joints[joint_id].idx_q()) = xmlRpcGetDouble(joint_pos, i % 3);
+    }
+
+  XmlRpc::XmlRpcValue contact_params;
+  robot_hw_nh.getParam("contact", contact_params);
+  stiffness_ = xmlRpcGetDouble(contact_params, "stiffness", 5000.);
+  damping_ = xmlRpcGetDouble(contact_params, "damping", 300.);
+  tangential_damping_ = xmlRpcGetDouble(contact_params, "tangential_damping", 500.);
+  mu_ = xmlRpcGetDouble(contact_params, "mu", 0.8);
+  foot_radius_ = xmlRpcGetDouble(contact_params, "foot_radius", 0.02);
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    if (!pin_model_->existFrame(robot_description_.getFootName(leg)))
+    {
+      ROS_ERROR_STREAM("Can not find the foot " << robot_description_.getFootName(leg) << " in the urdf");
+      return false;
+    }
+    foot_frame_ids_[leg] = pin_model_->getFrameId(robot_description_.getFootName(leg));
+  }
+
+  // Joints in the order of the pinocchio model, the controllers look them up by name: ignore id 0 (universe joint) and
+  // id 1 (root joint).
+  for (int i = 0; i < 12; ++i)
+  {
+    hardware_interface::JointStateHandle state_handle(pin_model_->names[2 + i], &joint_data_[i].pos_,
+                                                      &joint_data_[i].vel_, &joint_data_[i].tau_);
+    joint_state_interface_.registerHandle(state_handle);
+    hybrid_joint_interface_.registerHandle(HybridJointHandle(state_handle, &joint_data_[i].pos_des_,
+                                                             &joint_data_[i].vel_des_, &joint_data_[i].kp_,
+                                                             &joint_data_[i].kd_, &joint_data_[i].ff_));
+  }
+  registerInterface(&joint_state_interface_);
+  registerInterface(&hybrid_joint_interface_);
+
+  imu_sensor_interface_.registerHandle(hardware_interface::ImuSensorHandle(
+      "unitree_imu", "unitree_imu", imu_data_.ori, imu_data_.ori_cov, imu_data_.angular_vel, imu_data_.angular_vel_cov,
+      imu_data_.linear_acc, imu_data_.linear_acc_cov));
+  registerInterface(&imu_sensor_interface_);
+
+  contact_sensor_interface_.registerHandle(
+      ContactSensorHandle("feet", contact_state_, contact_probability_, contact_force_));
+  registerInterface(&contact_sensor_interface_);
+
+  ground_truth_pub_ =
+      std::make_shared<realtime_tools::RealtimePublisher<nav_msgs::Odometry>>(root_nh, "/ground_truth/state", 100);
+  ground_truth_pub_->msg_.header.frame_id = "world";
+  ground_truth_pub_->msg_.child_frame_id = "base";
+
+  pinocchio::forwardKinematics(*pin_model_, *pin_data_, q_, v_);
+  pinocchio::updateFramePlacements(*pin_model_, *pin_data_);
+  updateContact();
+  return true;
+}
+
+void HeadlessHW::read(const ros::Time& time, const ros::Duration& period)
+{
+  for (int i = 0; i < 12; ++i)
+  {
+    joint_data_[i].pos_ = q_(7 + i);
+    joint_data_[i].vel_ = v_(6 + i);
+    joint_data_[i].tau_ = tau_(6 + i);
+  }
+
+  // The free-flyer velocity and acceleration of pinocchio are expressed in the base frame
+  for (int i = 0; i < 4; ++i)
+    imu_data_.ori[i] = q_(3 + i);
+  for (int i = 0; i < 3; ++i)
+    imu_data_.angular_vel[i] = v_(3 + i);
+  Eigen::Quaterniond quat(q_(6), q_(3), q_(4), q_(5));
+  Eigen::Vector3d accel = pin_data_->ddq.head<3>() + v_.segment<3>(3).cross(v_.head<3>()) -
+                          quat.toRotationMatrix().transpose() * pin_model_->gravity.linear();
+  for (int i = 0; i < 3; ++i)
+    imu_data_.linear_acc[i] = accel(i);
+
+  // Set feedforward and velocity cmd to zero to avoid for safety when no controller setCommand
+  for (auto& joint : joint_data_)
+  {
+    joint.ff_ = 0.;
+    joint.vel_des_ = 0.;
+  }
+  publishGroundTruth(time);
+}
+
+void HeadlessHW::write(const ros::Time& time, const ros::Duration& period)
+{
+  for (int i = 0; i < 12; ++i)
+    joint_cmd_[i] = joint_data_[i];
+}
+
+void HeadlessHW::step(double dt)
+{
+  pinocchio::forwardKinematics(*pin_model_, *pin_data_, q_, v_);
+  pinocchio::updateFramePlacements(*pin_model_, *pin_data_);
+  updateContact();
+
+  for (int i = 0; i < 12; ++i)
+  {
+    const HeadlessJointData& cmd = joint_cmd_[i];
+    double tau = cmd.kp_ * (cmd.pos_des_ - q_(7 + i)) + cmd.kd_ * (cmd.vel_des_ - v_(6 + i)) + cmd.ff_;
+    double limit = pin_model_->effortLimit(6 + i);
+    tau_(6 + i) = limit > 0. ? std::min(std::max(tau, -limit), limit) : tau;
+  }
+  pinocchio::aba(*pin_model_, *pin_data_, q_, v_, tau_, fext_);
+  v_ += pin_data_->ddq * dt;
+  q_ = pinocchio::integrate(*pin_model_, q_, v_ * dt);
+}
+
+void HeadlessHW::updateContact()
+{
+  for (auto& force : fext_)
+    force.setZero();
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    pinocchio::FrameIndex frame_id = foot_frame_ids_[leg];
+    const Eigen::Vector3d& pos = pin_data_->oMf[frame_id].translation();
+    double depth = foot_radius_ - pos.z();
+    contact_state_[leg] = false;
+    contact_probability_[leg] = 0.;
+    contact_force_[leg] = 0.;
+    if (depth <= 0.)
+      continue;
+    Eigen::Vector3d vel =
+        pinocchio::getFrameVelocity(*pin_model_, *pin_data_, frame_id, pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED)
+            .linear();
+    double normal = std::max(stiffness_ * depth - damping_ * vel.z(), 0.);
+    Eigen::Vector2d tangential = -tangential_damping_ * vel.head<2>();
+    if (tangential.norm() > mu_ * normal)
+      tangential *= mu_ * normal / tangential.norm();
+    Eigen::Vector3d force(tangential.x(), tangential.y(), normal);
+    contact_state_[leg] = normal > 0.;
+    contact_probability_[leg] = contact_state_[leg] ? 1. : 0.;
+    contact_force_[leg] = normal;
+
+    // The external forces of ABA are expressed in the local frame of the joints
+    pinocchio::JointIndex joint_id = pin_model_->frames[frame_id].parent;
+    fext_[joint_id] += pin_data_->oMi[joint_id].actInv(pinocchio::Force(force, pos.cross(force)));
+  }
+}
+
+void HeadlessHW::publishGroundTruth(const ros::Time& time)
+{
+  if (!ground_truth_pub_->trylock())
+    return;
+  // The same as the p3d plugin of gazebo: pose and twist in the world frame
+  Eigen::Quaterniond quat(q_(6), q_(3), q_(4), q_(5));
+  Eigen::Vector3d linear_vel = quat * v_.head<3>();
+  Eigen::Vector3d angular_vel = quat * v_.segment<3>(3);
+  nav_msgs::Odometry& msg = ground_truth_pub_->msg_;
+  msg.header.stamp = time;
+  msg.pose.pose.position.x = q_(0);
+  msg.pose.pose.position.y = q_(1);
+  msg.pose.pose.position.z = q_(2);
+  msg.pose.pose.orientation.x = quat.x();
+  msg.pose.pose.orientation.y = quat.y();
+  msg.pose.pose.orientation.z = quat.z();
+  msg.pose.pose.orientation.w = quat.w();
+  msg.twist.twist.linear.x = linear_vel.x();
+  msg.twist.twist.linear.y = linear_vel.y();
+  msg.twist.twist.linear.z = linear_vel.z();
+  msg.twist.twist.angular.x = angular_vel.x();
+  msg.twist.twist.angular.y = angular_vel.y();
+  msg.twist.twist.angular.z = angular_vel.z();
+  ground_truth_pub_->unlockAndPublish();
+}
+
+}  // namespace cheetah_ros
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <tf/transform_datatypes.h>
+
+#include <cheetah_common/ros_utilities.h>
+
+// Watch the ground truth of the headless simulation and check that the base stands still at the reference height of
+// the locomotion controller. The ground is at zero, so the ground truth is comparable with the estimated height.
+TEST(HeadlessSim, Stand)
+{
+  ros::NodeHandle nh_p("~");
+  double settle_time = getParam(nh_p, "settle_time", 5.);
+  double test_time = getParam(nh_p, "test_time", 5.);
+  double height_tolerance = getParam(nh_p, "height_tolerance", 0.05);
+  double ref_height;
+  ASSERT_TRUE(ros::param::get("/controllers/locomotion_controller/traj/height", ref_height))
+      << "The locomotion controller is not configured";
+
+  double last_stamp = 0., min_height = 1e3, max_height = -1e3, sum_height = 0., max_tilt = 0.;
+  int samples = 0;
+  ros::NodeHandle nh;
+  ros::Subscriber sub =
+      nh.subscribe<nav_msgs::Odometry>("/ground_truth/state", 100, [&](const nav_msgs::Odometry::ConstPtr& msg) {
+        last_stamp = msg->header.stamp.toSec();
+        if (last_stamp < settle_time)  // The robot drops from the initial height and the controller starts
+          return;
+        double roll, pitch, yaw;
+        tf::Matrix3x3(tf::Quaternion(msg->pose.pose.orientation.x, msg->pose.pose.orientation.y,
+                                     msg->pose.pose.orientation.z, msg->pose.pose.orientation.w))
+            .getRPY(roll, pitch, yaw);
+        min_height = std::min(min_height, msg->pose.pose.position.z);
+        max_height = std::max(max_height, msg->pose.pose.position.z);
+        sum_height += msg->pose.pose.position.z;
+        max_tilt = std::max(max_tilt, std::max(std::abs(roll), std::abs(pitch)));
+        samples++;
+      });
+
+  // The simulated time may run faster or slower than the wall time
+  ros::WallTime timeout = ros::WallTime::now() + ros::WallDuration(100.);
+  while (ros::ok() && last_stamp < settle_time + test_time && ros::WallTime::now() < timeout)
+  {
+    ros::spinOnce();
+    ros::WallDuration(0.01).sleep();
+  }
+
+  ASSERT_GT(samples, 0) << "No ground truth after " << settle_time << " s of simulated time";
+  EXPECT_GT(min_height, ref_height - height_tolerance) << "The base collapsed below the reference " << ref_height;
+  EXPECT_NEAR(sum_height / samples, ref_height, height_tolerance) << "The base does not track the reference height";
+  EXPECT_LT(max_height - min_height, 0.05) << "The height of the base is not stable";
+  EXPECT_LT(max_tilt, 0.3) << "The base is not upright";
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "headless_sim_test");
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cheetah_common/cpp_types.h>
+
+namespace cheetah_ros
+{
+/*!
+ * Raibert heuristic with a capture point term, the same as the footstep of Cheetah-Software ConvexMPCLocomotion.
+ */
+template <typename T>
+class RaibertFootstepPlanner
+{
+public:
+  /*!
+   * @param k_vel : feedback gain of the velocity error
+   * @param max_offset : limit of the planar offset from the hip
+   */
+  RaibertFootstepPlanner(T k_vel, T max_offset) : k_vel_(k_vel), max_offset_(max_offset)
+  {
+  }
+
+  /*!
+   * Compute the landing position of one foot, all vectors are in world frame
+   * @param base_pos : the position of the base
+   * @param hip_pos : the position of the hip (under which the foot land at zero velocity)
+   * @param vel : the measured linear velocity of the base
+   * @param vel_cmd : the commanded linear velocity
+   * @param yaw_rate_cmd : the commanded yaw rate
+   * @param stance_time : how long the foot will stay on the ground
+   * @param time_to_touchdown : remaining time of the swing
+   * @return : the landing position on the ground (z = 0)
+   */
+  Vec3<T> plan(const Vec3<T>& base_pos, const Vec3<T>& hip_pos, const Vec3<T>& vel, const Vec3<T>& vel_cmd,
+               T yaw_rate_cmd, T stance_time, T time_to_touchdown) const
+  {
+    // Hip at touchdown, rotated by the commanded yaw rate to the middle of the stance
+    T yaw = yaw_rate_cmd * (time_to_touchdown + stance_time / 2);
+    T c = std::cos(yaw), s = std::sin(yaw);
+    Vec3<T> hip_rel = hip_pos - base_pos;
+    Vec3<T> pos;
+    pos << c * hip_rel.x() - s * hip_rel.y(), s * hip_rel.x() + c * hip_rel.y(), 0.;
+    pos += base_pos + vel_cmd * time_to_touchdown;
+
+    // Capture point term of the centripetal acceleration
+    T k_capture = base_pos.z() / 9.81 / 2 * yaw_rate_cmd;
+    Vec2<T> offset;
+    offset.x() = vel.x() * stance_time / 2 + k_vel_ * (vel.x() - vel_cmd.x()) + k_capture * vel.y();
+    offset.y() = vel.y() * stance_time / 2 + k_vel_ * (vel.y() - vel_cmd.y()) - k_capture * vel.x();
+    for (int i = 0; i < 2; ++i)
+      pos(i) += std::min(std::max(offset(i), -max_offset_), max_offset_);
+    pos.z() = 0.;
+    return pos;
+  }
+
+private:
+  T k_vel_, max_offset_;
+};
+
+}  // namespace cheetah_ros
@@ -22,13 +22,28 @@ public:
 
   void update(const ros::Time time)
   {
-    phase_ = std::fmod(time.toSec() / cycle_, 1.);
+    if (time < start_time_)  // Simulation reset
+      start_time_ = ros::Time(0.);
+    phase_ = std::fmod((time - start_time_).toSec() / cycle_, 1.);
+  }
+
+  // Restart the cycle at the given time, the phase is 0 at start_time.
+  void setStartTime(const ros::Time& start_time)
+  {
+    start_time_ = start_time;
   }
 
   DVec<T> getMpcTable(int horizon)
   {
     DVec<T> mpc_table(4 * horizon);
-    int iteration = phase_ * horizon;
+    getMpcTable(horizon, phase_, mpc_table);
+    return mpc_table;
+  }
+
+  // Fill a table which already has the size of 4 * horizon, no allocation.
+  void getMpcTable(int horizon, T phase, DVec<T>& mpc_table) const
+  {
+    int iteration = phase * horizon;
 
     for (int i = 0; i < horizon; i++)
     {
@@ -44,7 +59,6 @@ public:
           mpc_table[i * 4 + j] = 1;
       }
     }
-    return mpc_table;
   }
 
   Vec4<T> getSwingTime()
@@ -54,13 +68,24 @@ public:
     return (ones - durations_) * cycle_;
   }
 
+  Vec4<T> getStanceTime()
+  {
+    return durations_ * cycle_;
+  }
+
   T getCycle()
   {
     return cycle_;
   }
 
+  T getPhase()
+  {
+    return phase_;
+  }
+
 private:
-  T cycle_, phase_;
+  T cycle_, phase_{};
+  ros::Time start_time_;
 
   Vec4<T> offsets_;    // offset in 0.0 ~ 1.0
   Vec4<T> durations_;  // duration of step in 0.0 ~ 1.0
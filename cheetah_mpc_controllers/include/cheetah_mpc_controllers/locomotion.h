@@ -5,9 +5,13 @@
 #pragma once
 #include <cheetah_mpc_controllers/mpc_controller.h>
 #include <realtime_tools/realtime_buffer.h>
+#include <std_msgs/String.h>
+#include <geometry_msgs/Twist.h>
 
 #include "mpc_solver.h"
 #include "gait.h"
+#include "reference_trajectory.h"
+#include "footstep_planner.h"
 #include "cheetah_mpc_controllers/WeightConfig.h"
 
 namespace cheetah_ros
@@ -17,17 +21,48 @@ class LocomotionBase : public MpcController
 public:
   LocomotionBase() = default;
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& controller_nh) override;
+  void starting(const ros::Time& time) override;
   using FeetController::updateData;
   void updateCommand(const ros::Time& time, const ros::Duration& period) override;
 
 protected:
-  // TODO: Add setFootPlace() and setGait()
+  // The switch happens at the end of the current gait cycle, not real time safe (lookup by name).
+  bool setGait(const std::string& name);
 
 private:
-  void dynamicCallback(cheetah_ros::WeightConfig& config, uint32_t /*level*/);
+  void updateGait(const ros::Time& time);
+  void updateTraj(const ros::Time& time, const ros::Duration& period);
+  void updateFootstep();
+  // Table and trajectory of the next gait step for the step aligned trigger of the mpc
+  void updateNextStep(const ros::Time& time);
+  void gaitCmdCallback(const std_msgs::String::ConstPtr& msg);
+  void velCmdCallback(const geometry_msgs::Twist::ConstPtr& msg);
 
   std::map<std::string, OffsetDurationGaitRos<double>::Ptr> name2gaits_;
-  OffsetDurationGaitRos<double>::Ptr gait_;
+  OffsetDurationGaitRos<double>::Ptr gait_, next_gait_;
+  realtime_tools::RealtimeBuffer<OffsetDurationGaitRos<double>::Ptr> gait_buffer_;
+  double last_phase_{};
+  double gait_confidence_;  // Probability of contact expected in the stance of the gait
+  // Preallocated mpc tables, next_table_ is staged once when a switch is requested
+  VectorXd table_, next_table_;
+
+  struct VelCmd
+  {
+    geometry_msgs::Twist twist_;
+    ros::Time stamp_;  // Arrival of the command
+  };
+  std::shared_ptr<VelocityReference<double>> vel_reference_;
+  realtime_tools::RealtimeBuffer<VelCmd> vel_cmd_buffer_;
+  double vel_cmd_timeout_;  // Stop when no command arrives for this time, e.g. the teleop died, zero to disable
+  VectorXd ref_traj_;
+  VectorXd next_step_table_, next_step_traj_;
+
+  std::shared_ptr<RaibertFootstepPlanner<double>> footstep_planner_;
+  pinocchio::FrameIndex hip_frame_ids_[4];
+  Vector3d hip_offsets_[4];  // From the hip (abad) joint to the thigh joint, in base frame
+  double swing_height_;
+
+  ros::Subscriber gait_cmd_sub_, vel_cmd_sub_;
 };
 
 }  // namespace cheetah_ros
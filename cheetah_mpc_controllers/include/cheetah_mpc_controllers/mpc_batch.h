@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mpc_solver.h"
+#include "worker_pool.h"
+
+#include <Eigen/StdVector>
+
+namespace cheetah_ros
+{
+// One problem of the batch, the layout of gait_table_ and traj_ is the same as MpcSolverBase::solve()
+struct MpcCase
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  RobotState state_;
+  VectorXd gait_table_, traj_;
+  Matrix<double, 13, 1> weight_;
+  double alpha_, dt_;
+  int horizon_;
+};
+
+struct MpcResult
+{
+  bool feasible_;
+  double cost_;        // Objective of the QP plus its constant term, half the tracking cost
+  Vector3d force_[4];  // Ground reaction forces of the first step
+  double solve_time_;  // Second, formulation included
+};
+
+using MpcCases = std::vector<MpcCase, Eigen::aligned_allocator<MpcCase>>;
+
+/*!
+ * Solve many independent mpc problems offline on all cores, e.g. for sweeping the weights without a simulator. The
+ * problems are built by MpcFormulation and solved by QpOasesSolver, the same as online.
+ */
+class MpcBatchEvaluator
+{
+public:
+  // num_threads < 0 uses all cores
+  MpcBatchEvaluator(double mass, double gravity, double mu, const Matrix3d& inertia, double f_max,
+                    int num_threads = -1);
+
+  void evaluate(const MpcCases& cases, std::vector<MpcResult>& results);
+
+  static MpcResult evaluate(const MpcCase& mpc_case, double mass, double gravity, double mu, const Matrix3d& inertia,
+                            double f_max);
+
+private:
+  double mass_, gravity_, mu_, f_max_;
+  Matrix3d inertia_;
+  WorkerPool pool_;
+};
+
+}  // namespace cheetah_ros
@@ -5,9 +5,13 @@
 #pragma once
 #include <cheetah_basic_controllers/feet_controller.h>
 #include <realtime_tools/realtime_buffer.h>
+#include <realtime_tools/realtime_publisher.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 
 #include "mpc_solver.h"
+#include "multi_hypothesis_solver.h"
 #include "gait.h"
+#include "wbc.h"
 #include "cheetah_mpc_controllers/WeightConfig.h"
 
 namespace cheetah_ros
@@ -23,16 +27,58 @@ public:
 protected:
   void setTraj(const VectorXd& traj);
   void setGaitTable(const VectorXd& table);
+  // For the step aligned trigger: the gait table and trajectory of the gait step which starts at boundary
+  void setNextStep(const ros::Time& boundary, double step_duration, const VectorXd& table, const VectorXd& traj);
+  // Distribute the feet forces by the whole body control, fall back to J^T f when it is disabled or fails
+  void updateJointTorque(const Eigen::Vector3d (&foot_force)[4]) override;
 
   std::shared_ptr<MpcSolverBase> solver_;
-  int horizon_;
+  bool step_aligned_;
 
 private:
+  // Get mass and inertia from the pinocchio model unless they are overridden by the mpc params
+  bool initInertial(XmlRpc::XmlRpcValue& mpc_params, double& mass, Matrix3d& inertia, double& gravity);
+  // Refresh the centroidal inertia at the mpc rate when the joints move more than the threshold
+  void updateInertia(const ros::Time& time);
+  // Shrink the horizon when the solve time exceeds the deadline and grow it back when there is margin
+  void updateHorizon();
+  void publishDiagnostics(const ros::Time& time);
+  // Launch the solve of the next gait step early by the solve time, so that it is ready at the boundary
+  void launchStep(const ros::Time& time);
   void dynamicCallback(cheetah_ros::WeightConfig& config, uint32_t /*level*/);
 
   VectorXd gait_table_;
   VectorXd traj_;
 
+  // Step aligned trigger
+  double lead_margin_, step_duration_{};
+  ros::Time step_boundary_, launched_boundary_;
+  VectorXd step_table_, step_traj_;
+
+  // Configuration dependent inertia, use its own data since pin_data_ holds the kinematics of the current tick
+  bool update_inertia_;
+  double inertia_threshold_;
+  std::shared_ptr<pinocchio::Data> pin_data_inertia_;
+  VectorXd inertia_q_, inertia_v_;
+  ros::Time last_inertia_update_;
+
+  // Adaptive horizon, the duration of the horizon (horizon * dt) is kept
+  bool adaptive_horizon_;
+  double deadline_, grow_ratio_;
+  int min_horizon_, max_horizon_, window_;
+  int last_timeouts_{};
+  std::shared_ptr<realtime_tools::RealtimePublisher<diagnostic_msgs::DiagnosticArray>> diag_pub_;
+  ros::Time last_diag_;
+
+  // Whole body control, use its own data for the same reason as above
+  std::shared_ptr<Wbc> wbc_;
+  std::shared_ptr<pinocchio::Data> pin_data_wbc_;
+  VectorXd wbc_a_;
+  Wbc::MatM wbc_m_;
+  Vec18<double> wbc_h_;
+  Wbc::MatJ wbc_j_;
+  Vec12<double> wbc_jdot_v_, wbc_foot_force_, wbc_tau_;
+
   // Dynamic reconfigure
   std::shared_ptr<dynamic_reconfigure::Server<cheetah_ros::WeightConfig>> dynamic_srv_{};
   realtime_tools::RealtimeBuffer<cheetah_ros::WeightConfig> weight_buffer_;
@@ -19,46 +19,58 @@ using Eigen::Quaterniond;
 using Eigen::Vector3d;
 using Eigen::VectorXd;
 
-class MpcFormulation  // TODO: template for float
+/*!
+ * Condensed QP of the convex mpc. The matrices are built in T, float for the single precision build. The trajectory and
+ * the gait table come from the controllers in double and are converted element by element.
+ */
+template <typename T>
+class MpcFormulationTpl
 {
 public:
   static constexpr int STATE_DIM = 13;   // 6 dof pose + 6 dof velocity + 1 gravity.
   static constexpr int ACTION_DIM = 12;  // 4 ground reaction force.
-  const double BIG_VALUE = 1e10;
+  const T BIG_VALUE = 1e10;
 
-  void setup(int horizon, const Matrix<double, STATE_DIM, 1>& weight, double alpha, double final_cost_scale);
+  void setup(int horizon, const Matrix<T, STATE_DIM, 1>& weight, T alpha, T final_cost_scale);
 
-  void buildStateSpace(double mass, const Matrix3d& inertia, const RobotState& state);
-  void buildQp(double dt);
+  void buildStateSpace(T mass, const Mat3<T>& inertia, const RobotStateTpl<T>& state);
+  void buildQp(T dt);
 
-  const Matrix<double, Dynamic, Dynamic, Eigen::RowMajor>& buildHessianMat();
-  const VectorXd& buildGVec(double gravity, const RobotState& state, const Matrix<double, Dynamic, 1>& traj);
-  const Matrix<double, Dynamic, Dynamic, Eigen::RowMajor>& buildConstrainMat(double mu);
-  const VectorXd& buildConstrainUpperBound(double f_max, const VectorXd& gait_table);
-  const VectorXd& buildConstrainLowerBound();
+  const Matrix<T, Dynamic, Dynamic, Eigen::RowMajor>& buildHessianMat();
+  // x_0 is forward integrated by prediction (second) with the constant force, to compensate the solve latency
+  const DVec<T>& buildGVec(T gravity, const RobotStateTpl<T>& state, const Matrix<double, Dynamic, 1>& traj,
+                           T prediction = 0., const Matrix<T, ACTION_DIM, 1>& force = Matrix<T, ACTION_DIM, 1>::Zero());
+  const Matrix<T, Dynamic, Dynamic, Eigen::RowMajor>& buildConstrainMat(T mu);
+  const DVec<T>& buildConstrainUpperBound(T f_max, const VectorXd& gait_table);
+  const DVec<T>& buildConstrainLowerBound();
 
   int horizon_;
-  double final_cost_scale_;
+  T final_cost_scale_;
 
   // Final QP Formation
   // 1/2 U^{-T} H U + U^{T} g
-  Matrix<double, Dynamic, Dynamic, Eigen::RowMajor> h_;  // hessian Matrix
-  VectorXd g_;                                           // g vector
-  Matrix<double, Dynamic, Dynamic, Eigen::RowMajor> a_;  // constrain matrix
-  VectorXd ub_a_;                                        // upper bound of output
-  VectorXd lb_a_;                                        // lower bound of output
+  Matrix<T, Dynamic, Dynamic, Eigen::RowMajor> h_;  // hessian Matrix
+  DVec<T> g_;                                       // g vector
+  T cost_offset_{};  // Constant term left out of the QP, with it the objective is half the tracking cost (>= 0)
+  Matrix<T, Dynamic, Dynamic, Eigen::RowMajor> a_;  // constrain matrix
+  DVec<T> ub_a_;                                    // upper bound of output
+  DVec<T> lb_a_;                                    // lower bound of output
 
 private:
+  void discretize(T dt, Matrix<T, STATE_DIM, STATE_DIM>& a_dt, Matrix<T, STATE_DIM, ACTION_DIM>& b_dt);
+
   // State Space Model
-  Matrix<double, STATE_DIM, STATE_DIM> a_c_;
-  Matrix<double, STATE_DIM, ACTION_DIM> b_c_;
-  Matrix<double, Dynamic, STATE_DIM> a_qp_;
-  MatrixXd b_qp_;
+  Matrix<T, STATE_DIM, STATE_DIM> a_c_;
+  Matrix<T, STATE_DIM, ACTION_DIM> b_c_;
+  Matrix<T, Dynamic, STATE_DIM> a_qp_;
+  DMat<T> b_qp_;
 
   // Weight
   // L matrix: Diagonal matrix of weights for state deviations
-  Eigen::DiagonalMatrix<double, Eigen::Dynamic, Eigen::Dynamic> l_;
-  Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> alpha_;  // u cost
+  Eigen::DiagonalMatrix<T, Eigen::Dynamic, Eigen::Dynamic> l_;
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> alpha_;  // u cost
 };
 
+using MpcFormulation = MpcFormulationTpl<double>;
+
 }  // namespace cheetah_ros
@@ -4,7 +4,11 @@
 
 #pragma once
 #include "mpc_formulation.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <mutex>
+#include <numeric>
 #include <thread>
 #include <qpOASES.hpp>
 #include <ros/ros.h>
@@ -14,34 +18,70 @@ namespace cheetah_ros
 class MpcSolverBase
 {
 public:
+  // Single precision with the CHEETAH_FLOAT32 option of cheetah_common, the solution is in double anyway
+  using Formulation = MpcFormulationTpl<ControlScalar>;
+
+  struct Statistics
+  {
+    double mean_, p50_, p95_, max_;  // Latency from the launch to the solution in second, over the recent solves
+    int count_;                      // Solves since the last change of the formulation
+    int timeouts_;                   // Solves skipped since the last one was still running
+  };
+
   virtual ~MpcSolverBase(){};
   MpcSolverBase(double mass, double gravity, double mu, const Matrix3d& inertia)
-    : mass_(mass), gravity_(gravity), mu_(mu), inertia_(inertia)
+    : mpc_formulation_(std::make_shared<Formulation>())
+    , horizon_(0)
+    , dt_(0.)
+    , mass_(mass)
+    , gravity_(gravity)
+    , mu_(mu)
+    , inertia_(inertia)
+    , inertia_next_(inertia)
   {
     solution_.resize(4);
     for (auto& solution : solution_)
       solution.setZero();
+    solution_pending_ = solution_;
+    solution_rt_ = solution_;
   }
 
+  /*!
+   * Stage new parameters, should be called from a non real-time thread (e.g. dynamic reconfigure). The formulation is
+   * allocated here and swapped in by solve() when no solve is running, the first call takes effect immediately.
+   */
   void setup(double dt, int horizon, double f_max, const Matrix<double, 13, 1>& weight, double alpha,
              double final_cost_scale)
   {
-    dt_ = dt;
-    f_max_ = f_max;
-    weight_ = weight;
-    alpha_ = alpha;
-    horizon_ = horizon;
-    final_cost_scale_ = final_cost_scale;
-    mpc_formulation_.setup(horizon, weight, alpha, final_cost_scale);
+    stage(Setup{ dt, f_max, alpha, final_cost_scale, horizon, weight });
+    if (!setup_applied_)  // No solve is running before the first setup
+    {
+      setup_applied_ = true;
+      std::lock_guard<std::mutex> guard(mutex_);
+      applyPending();
+    }
   }
 
+  // Called from the real-time thread, the new formulation is allocated by the solving thread
   void setHorizon(int horizon, double dt, double final_cost_scale)
   {
-    if (horizon_ != horizon || dt_ != dt || final_cost_scale_ != final_cost_scale)
+    if (horizon_request_ != horizon || dt_request_ != dt || final_cost_scale_request_ != final_cost_scale)
       horizon_changed_ = true;
-    horizon_ = horizon;
-    dt_ = dt;
-    final_cost_scale_ = final_cost_scale;
+    horizon_request_ = horizon;
+    dt_request_ = dt;
+    final_cost_scale_request_ = final_cost_scale;
+  }
+
+  // Predict the initial state by the mean solve latency, when the solve is not launched ahead of its apply time
+  void setDelayCompensation(bool enable)
+  {
+    delay_compensation_ = enable;
+  }
+
+  // Take effect from the next solve, should be called from the same thread as solve()
+  void setInertia(const Matrix3d& inertia)
+  {
+    inertia_next_ = inertia;
   }
 
   void solve(ros::Time time, const RobotState& state, const VectorXd& gait_table, const Matrix<double, Dynamic, 1>& traj)
@@ -51,32 +91,70 @@ public:
     if (dt < 0)  // Simulation reset
       last_update_ = time;
     if (dt > dt_)
+      launch(time, time, state, gait_table, traj);
+  }
+
+  /*!
+   * Launch a solve now if the previous one is finished, the trigger is up to the caller
+   * @param apply_time : the initial state is predicted to this time and the solution is held until it. If it is not
+   * later than time, the initial state is predicted by the mean latency when the delay compensation is enabled
+   * @return : false if the solve is skipped
+   */
+  bool launch(ros::Time time, ros::Time apply_time, const RobotState& state, const VectorXd& gait_table,
+              const Matrix<double, Dynamic, 1>& traj)
+  {
+    std::unique_lock<std::mutex> guard(mutex_, std::try_to_lock);
+    if (!guard.owns_lock())
+    {
+      timeouts_++;
+      ROS_WARN("Solve timeout.");
+      return false;
+    }
+    // Solve boundary, the solving thread is idle
+    applyPending();
+    statistics_rt_ = statistics_;
+    statistics_rt_.timeouts_ = timeouts_;
+    if (gait_table.size() != 4 * horizon_ || traj.size() != 12 * horizon_)
+      return false;  // The caller follows getHorizon() from the next update
+    if (horizon_changed_)
+    {
+      horizon_changed_ = false;
+      stage_horizon_ = true;
+      stage_horizon_setup_ = Setup{ dt_request_, f_max_, alpha_, final_cost_scale_request_, horizon_request_, weight_ };
+    }
+    last_update_ = time;
+    launch_stamp_ = std::chrono::steady_clock::now();
+    apply_time_ = apply_time;
+    if (apply_time > time)
+      prediction_ = (apply_time - time).toSec();
+    else
+      prediction_ = delay_compensation_ ? statistics_rt_.mean_ : 0.;
+    inertia_ = inertia_next_;
+    state_ = state.cast<ControlScalar>();
+    gait_table_ = gait_table;
+    traj_ = traj;
+
+    thread_ = std::make_shared<std::thread>(std::thread(&MpcSolverBase::solvingThread, this));
+    thread_->detach();
+    return true;
+  }
+
+  // The latest solution whose apply time has come, should be called from the same thread as solve()
+  const std::vector<Vec3<double>>& getSolution(ros::Time time)
+  {
+    std::unique_lock<std::mutex> guard(solution_mutex_, std::try_to_lock);
+    if (guard.owns_lock() && solution_ready_ && time >= solution_apply_time_)
     {
-      std::unique_lock<std::mutex> guard(mutex_, std::try_to_lock);
-      if (guard.owns_lock())
-      {
-        if (horizon_changed_)
-        {
-          horizon_changed_ = false;
-          setup(dt_, horizon_, f_max_, weight_, alpha_, final_cost_scale_);
-          //          ROS_INFO_STREAM("horizon: " << horizon_ << " dt: " << dt_);
-        }
-        last_update_ = time;
-        state_ = state;
-        gait_table_ = gait_table;
-        traj_ = traj;
-
-        thread_ = std::make_shared<std::thread>(std::thread(&MpcSolverBase::solvingThread, this));
-        thread_->detach();
-      }
-      else
-        ROS_WARN("Solve timeout.");
+      solution_ready_ = false;
+      for (int leg = 0; leg < 4; ++leg)
+        solution_rt_[leg] = solution_pending_[leg];
     }
+    return solution_rt_;
   }
 
   const std::vector<Vec3<double>>& getSolution()
   {
-    return solution_;
+    return getSolution(ros::TIME_MAX);
   }
 
   int getHorizon()
@@ -89,17 +167,37 @@ public:
     return dt_;
   };
 
+  // Statistics of the solves finished before the last launch, for the thread calling solve()
+  const Statistics& getStatistics()
+  {
+    return statistics_rt_;
+  }
+
 protected:
   void solvingThread()
   {
     std::lock_guard<std::mutex> guard(mutex_);
     formulate();
     solving();
+    recordSolveTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - launch_stamp_).count());
+    {
+      std::lock_guard<std::mutex> solution_guard(solution_mutex_);
+      for (int leg = 0; leg < 4; ++leg)
+        solution_pending_[leg] = solution_[leg];
+      solution_apply_time_ = apply_time_;
+      solution_ready_ = true;
+    }
+    if (stage_horizon_)
+    {
+      stage_horizon_ = false;
+      stage(stage_horizon_setup_);
+    }
   };
 
   virtual void solving() = 0;
 
-  MpcFormulation mpc_formulation_;
+  // Only touched by the solving thread, or by solve() when the solving thread is idle
+  std::shared_ptr<Formulation> mpc_formulation_;
   std::vector<Vec3<double>> solution_;
 
   std::mutex mutex_;
@@ -108,30 +206,113 @@ protected:
   double final_cost_scale_;
 
 private:
+  struct Setup
+  {
+    double dt_, f_max_, alpha_, final_cost_scale_;
+    int horizon_;
+    Matrix<double, 13, 1> weight_;
+  };
+
   void formulate()
   {
-    mpc_formulation_.buildStateSpace(mass_, inertia_, state_);
-    mpc_formulation_.buildQp(dt_);
-    mpc_formulation_.buildHessianMat();
-    mpc_formulation_.buildGVec(gravity_, state_, traj_);
-    mpc_formulation_.buildConstrainMat(mu_);
-    mpc_formulation_.buildConstrainUpperBound(f_max_, gait_table_);
-    mpc_formulation_.buildConstrainLowerBound();
+    mpc_formulation_->buildStateSpace(mass_, inertia_.cast<ControlScalar>(), state_);
+    mpc_formulation_->buildQp(dt_);
+    mpc_formulation_->buildHessianMat();
+    // The forces of the last solution are applied until the new one is ready
+    Matrix<ControlScalar, 12, 1> force;
+    for (int leg = 0; leg < 4; ++leg)
+      force.segment<3>(3 * leg) = (gait_table_[leg] * solution_[leg]).cast<ControlScalar>();
+    mpc_formulation_->buildGVec(gravity_, state_, traj_, prediction_, force);
+    mpc_formulation_->buildConstrainMat(mu_);
+    mpc_formulation_->buildConstrainUpperBound(f_max_, gait_table_);
+    mpc_formulation_->buildConstrainLowerBound();
   }
 
-  ros::Time last_update_;
+  void recordSolveTime(double time)
+  {
+    solve_times_[solve_count_ % solve_times_.size()] = time;
+    solve_count_++;
+    int n = std::min(solve_count_, static_cast<int>(solve_times_.size()));
+    std::copy(solve_times_.begin(), solve_times_.begin() + n, sorted_times_.begin());
+    std::sort(sorted_times_.begin(), sorted_times_.begin() + n);
+    statistics_.p50_ = sorted_times_[n / 2];
+    statistics_.p95_ = sorted_times_[std::min(n - 1, n * 95 / 100)];
+    statistics_.max_ = sorted_times_[n - 1];
+    statistics_.mean_ = std::accumulate(sorted_times_.begin(), sorted_times_.begin() + n, 0.) / n;
+    statistics_.count_ = solve_count_;
+  }
+
+  // Allocate a formulation for the setup, out of the real-time thread
+  void stage(const Setup& setup)
+  {
+    auto formulation = std::make_shared<Formulation>();
+    formulation->setup(setup.horizon_, setup.weight_.cast<ControlScalar>(), setup.alpha_, setup.final_cost_scale_);
+    std::lock_guard<std::mutex> guard(setup_mutex_);
+    pending_setup_ = setup;
+    pending_formulation_.swap(formulation);  // The replaced one is released here instead of in the real-time thread
+    pending_ready_ = true;
+  }
+
+  // Swap in the staged formulation without any allocation, should hold mutex_
+  void applyPending()
+  {
+    std::unique_lock<std::mutex> guard(setup_mutex_, std::try_to_lock);
+    if (!guard.owns_lock() || !pending_ready_)
+      return;
+    pending_ready_ = false;
+    mpc_formulation_.swap(pending_formulation_);
+    dt_ = pending_setup_.dt_;
+    f_max_ = pending_setup_.f_max_;
+    alpha_ = pending_setup_.alpha_;
+    final_cost_scale_ = pending_setup_.final_cost_scale_;
+    horizon_ = pending_setup_.horizon_;
+    weight_ = pending_setup_.weight_;
+    horizon_request_ = horizon_;
+    dt_request_ = dt_;
+    final_cost_scale_request_ = final_cost_scale_;
+    // The solve time of the previous formulation does not count
+    solve_count_ = 0;
+    statistics_ = Statistics{};
+  }
+
+  ros::Time last_update_, apply_time_;
+  std::chrono::steady_clock::time_point launch_stamp_;
+  double prediction_{};
+  bool delay_compensation_{ false };
 
   double dt_, mass_, gravity_, mu_, f_max_;
-  Matrix3d inertia_;
-  RobotState state_;
+  Matrix3d inertia_, inertia_next_;
+  RobotStateTpl<ControlScalar> state_;
   Matrix<double, Dynamic, 1> traj_;
   VectorXd gait_table_;
 
-  // Only for setHorizon()
   Matrix<double, 13, 1> weight_;
   double alpha_;
 
-  bool horizon_changed_;
+  // Staged by setup() or the solving thread, guarded by setup_mutex_
+  std::mutex setup_mutex_;
+  Setup pending_setup_;
+  std::shared_ptr<Formulation> pending_formulation_;
+  bool pending_ready_{ false };
+  bool setup_applied_{ false };  // Only for setup()
+
+  // Only for setHorizon()
+  int horizon_request_{};
+  double dt_request_{}, final_cost_scale_request_{};
+  bool horizon_changed_{ false }, stage_horizon_{ false };
+  Setup stage_horizon_setup_;
+
+  // Solve time, written by the solving thread and copied by solve() when the solving thread is idle
+  std::array<double, 100> solve_times_{}, sorted_times_{};
+  int solve_count_{};
+  Statistics statistics_{}, statistics_rt_{};
+  int timeouts_{};
+
+  // Solution handed from the solving thread to the thread calling getSolution()
+  std::mutex solution_mutex_;
+  std::vector<Vec3<double>> solution_pending_, solution_rt_;
+  ros::Time solution_apply_time_;
+  bool solution_ready_{ false };
 };
 
 class QpOasesSolver : public MpcSolverBase
@@ -139,45 +320,38 @@ class QpOasesSolver : public MpcSolverBase
 public:
   using MpcSolverBase::MpcSolverBase;
 
-protected:
-  void solving() override
+  // Solve the QP of a formulation which is already built, also used by the offline evaluation and the accuracy test
+  template <typename T>
+  static bool solveQp(const MpcFormulationTpl<T>& formulation, const T* a, qpOASES::real_t* sol, double& cost)
   {
-    auto qp_problem =
-        qpOASES::QProblem(12 * mpc_formulation_.horizon_, 20 * mpc_formulation_.horizon_);  // TODO: Test SQProblem
+    // qpOASES is built in double, a single precision formulation is copied at the boundary
+    int n = 12 * formulation.horizon_, m = 20 * formulation.horizon_;
+    std::vector<qpOASES::real_t> h_buffer, g_buffer, a_buffer, lb_a_buffer, ub_a_buffer;
+    const qpOASES::real_t* h = qpData(formulation.h_.data(), n * n, h_buffer);
+    const qpOASES::real_t* g = qpData(formulation.g_.data(), n, g_buffer);
+    const qpOASES::real_t* a_qp = qpData(a, m * n, a_buffer);
+    const qpOASES::real_t* lb_a = qpData(formulation.lb_a_.data(), m, lb_a_buffer);
+    const qpOASES::real_t* ub_a = qpData(formulation.ub_a_.data(), m, ub_a_buffer);
+
+    auto qp_problem = qpOASES::QProblem(12 * formulation.horizon_, 20 * formulation.horizon_);  // TODO: Test SQProblem
     qpOASES::Options options;
     options.setToMPC();
     //    options.enableEqualities = qpOASES::BT_TRUE;
     options.printLevel = qpOASES::PL_NONE;
     qp_problem.setOptions(options);
     int n_wsr = 200;
-    qpOASES::returnValue rvalue =
-        qp_problem.init(mpc_formulation_.h_.data(), mpc_formulation_.g_.data(), mpc_formulation_.a_.data(), nullptr,
-                        nullptr, mpc_formulation_.lb_a_.data(), mpc_formulation_.ub_a_.data(), n_wsr);
+    qpOASES::returnValue rvalue = qp_problem.init(h, g, a_qp, nullptr, nullptr, lb_a, ub_a, n_wsr);
     printFailedInit(rvalue);
-
     if (rvalue != qpOASES::SUCCESSFUL_RETURN)
-    {
-      for (auto& solution : solution_)
-        solution.setZero();
-      return;
-    }
+      return false;
 
-    std::vector<qpOASES::real_t> qp_sol(12 * mpc_formulation_.horizon_, 0);
-
-    if (qp_problem.getPrimalSolution(qp_sol.data()) != qpOASES::SUCCESSFUL_RETURN)
+    if (qp_problem.getPrimalSolution(sol) != qpOASES::SUCCESSFUL_RETURN)
       ROS_WARN("Failed to solve mpc!\n");
-
-    for (int leg = 0; leg < 4; ++leg)
-    {
-      solution_[leg].x() = qp_sol[3 * leg];
-      solution_[leg].y() = qp_sol[3 * leg + 1];
-      solution_[leg].z() = qp_sol[3 * leg + 2];
-      if (solution_[leg].norm() > 1e3)
-        ROS_ERROR_STREAM(solution_[leg]);
-    }
+    cost = qp_problem.getObjVal() + formulation.cost_offset_;
+    return true;
   }
 
-  void printFailedInit(qpOASES::returnValue rvalue)
+  static void printFailedInit(qpOASES::returnValue rvalue)
   {
     switch (rvalue)
     {
@@ -209,6 +383,54 @@ protected:
         break;
     }
   }
+
+protected:
+  void solving() override
+  {
+    std::vector<qpOASES::real_t> qp_sol(12 * mpc_formulation_->horizon_, 0);
+    double cost;
+    if (!solveQp(mpc_formulation_->a_.data(), qp_sol.data(), cost))
+    {
+      for (auto& solution : solution_)
+        solution.setZero();
+      return;
+    }
+    setSolution(qp_sol.data());
+  }
+
+  /*!
+   * Solve the QP built by the formulation with the constraint matrix a, thread safe as long as a and sol are not shared
+   * @param cost : the objective of the QP plus its constant term, i.e. half the tracking cost of the solution
+   * @return : false if the initialization failed
+   */
+  bool solveQp(const ControlScalar* a, qpOASES::real_t* sol, double& cost)
+  {
+    return solveQp(*mpc_formulation_, a, sol, cost);
+  }
+
+  static const qpOASES::real_t* qpData(const double* data, int /*size*/, std::vector<qpOASES::real_t>& /*buffer*/)
+  {
+    return data;
+  }
+
+  static const qpOASES::real_t* qpData(const float* data, int size, std::vector<qpOASES::real_t>& buffer)
+  {
+    buffer.assign(data, data + size);
+    return buffer.data();
+  }
+
+  // Take the forces of the first step
+  void setSolution(const qpOASES::real_t* sol)
+  {
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      solution_[leg].x() = sol[3 * leg];
+      solution_[leg].y() = sol[3 * leg + 1];
+      solution_[leg].z() = sol[3 * leg + 2];
+      if (solution_[leg].norm() > 1e3)
+        ROS_ERROR_STREAM(solution_[leg]);
+    }
+  }
 };
 
 }  // namespace cheetah_ros
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "mpc_solver.h"
+#include "worker_pool.h"
+
+namespace cheetah_ros
+{
+/*!
+ * Solve the same mpc under several friction coefficients in parallel. All hypotheses share the hessian and the g
+ * vector, only the friction cone differs, so a larger coefficient never costs more and the lowest cost alone would
+ * always pick the least conservative one. Instead the smallest coefficient whose cost plus penalty stays within the
+ * tolerance of the nominal one (the mu of the constructor) is applied: a cone that barely limits the plan is taken
+ * as safe, a cone that forces a much worse plan is not.
+ */
+class MultiHypothesisSolver : public QpOasesSolver
+{
+public:
+  struct Hypothesis
+  {
+    double mu_;
+    double penalty_;  // Added to the cost, e.g. to disfavor a coefficient
+  };
+
+  /*!
+   * @param nominal_penalty : penalty of the nominal hypothesis
+   * @param cost_tolerance : relative increase of the cost over the nominal one which is accepted for a smaller mu,
+   * the cost is the tracking cost of the plan (the QP objective plus its constant term) so it is never negative
+   */
+  MultiHypothesisSolver(double mass, double gravity, double mu, const Matrix3d& inertia,
+                        const std::vector<Hypothesis>& hypotheses, double nominal_penalty, double cost_tolerance,
+                        int num_threads)
+    : QpOasesSolver(mass, gravity, mu, inertia), cost_tolerance_(cost_tolerance), pool_(num_threads)
+  {
+    hypotheses_.push_back(Hypothesis{ mu, nominal_penalty });
+    hypotheses_.insert(hypotheses_.end(), hypotheses.begin(), hypotheses.end());
+    results_.resize(hypotheses_.size());
+  }
+
+  // Which hypothesis is applied by the last solve, -1 if all of them failed
+  int getSelected()
+  {
+    return selected_;
+  }
+
+protected:
+  void solving() override
+  {
+    int horizon = mpc_formulation_->horizon_;
+    pool_.run(hypotheses_.size(), [this, horizon](int i) {
+      Result& result = results_[i];
+      if (result.sol_.size() != static_cast<size_t>(12 * horizon))  // Only when the horizon is reconfigured
+      {
+        result.sol_.resize(12 * horizon);
+        result.a_.resize(20 * horizon, 12 * horizon);
+      }
+      const ControlScalar* a = mpc_formulation_->a_.data();
+      if (i != 0)
+      {
+        buildConstrainMat(hypotheses_[i].mu_, horizon, result.a_);
+        a = result.a_.data();
+      }
+      result.feasible_ = solveQp(a, result.sol_.data(), result.cost_);
+    });
+
+    // The reference is the nominal hypothesis, or the cheapest one if the nominal QP failed
+    int reference = -1;
+    for (size_t i = 0; i < results_.size(); ++i)
+      if (results_[i].feasible_ && (reference == -1 || (reference != 0 && getCost(i) < getCost(reference))))
+        reference = i;
+    selected_ = reference;
+    if (reference != -1)
+    {
+      double max_cost = (1. + cost_tolerance_) * getCost(reference);
+      for (size_t i = 0; i < results_.size(); ++i)
+        if (results_[i].feasible_ && getCost(i) <= max_cost && hypotheses_[i].mu_ < hypotheses_[selected_].mu_)
+          selected_ = i;
+    }
+    if (selected_ == -1)
+    {
+      for (auto& solution : solution_)
+        solution.setZero();
+      return;
+    }
+    setSolution(results_[selected_].sol_.data());
+  }
+
+private:
+  double getCost(int i) const
+  {
+    return results_[i].cost_ + hypotheses_[i].penalty_;
+  }
+
+  struct Result
+  {
+    std::vector<qpOASES::real_t> sol_;
+    Matrix<ControlScalar, Dynamic, Dynamic, Eigen::RowMajor> a_;
+    double cost_;
+    bool feasible_;
+  };
+
+  // The same as MpcFormulation::buildConstrainMat()
+  static void buildConstrainMat(ControlScalar mu, int horizon,
+                                Matrix<ControlScalar, Dynamic, Dynamic, Eigen::RowMajor>& a)
+  {
+    a.setZero();
+    ControlScalar mu_inv = 1. / mu;
+    Matrix<ControlScalar, 5, 3> a_block;
+    a_block << mu_inv, 0, 1., -mu_inv, 0, 1., 0, mu_inv, 1., 0, -mu_inv, 1., 0, 0, 1.;
+    for (int i = 0; i < horizon * 4; i++)
+      a.block(i * 5, i * 3, 5, 3) = a_block;
+  }
+
+  std::vector<Hypothesis> hypotheses_;
+  double cost_tolerance_;
+  std::vector<Result> results_;
+  int selected_{ -1 };
+  WorkerPool pool_;
+};
+
+}  // namespace cheetah_ros
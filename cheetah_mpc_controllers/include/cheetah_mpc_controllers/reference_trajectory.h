@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cheetah_common/cpp_types.h>
+#include <cheetah_common/math_utilities.h>
+
+namespace cheetah_ros
+{
+/*!
+ * Generate the body reference of the mpc from a velocity command. The desired planar pose is integrated every tick
+ * and the horizon is filled in the layout of MpcFormulation::buildGVec():
+ * [roll, pitch, yaw, x, y, z, rate_roll, rate_pitch, rate_yaw, vel_x, vel_y, vel_z] per step.
+ */
+template <typename T>
+class VelocityReference
+{
+public:
+  VelocityReference(T height, T max_pos_error) : height_(height), max_pos_error_(max_pos_error)
+  {
+    pos_des_.setZero();
+    vel_cmd_.setZero();
+  }
+
+  /*!
+   * Integrate the desired pose by one tick
+   * @param state : the estimated state of the robot
+   * @param vel_cmd : linear velocity command in the yaw frame (z is ignored)
+   * @param yaw_rate_cmd : yaw rate command
+   * @param period : time since the last update
+   */
+  void update(const RobotState& state, const Vec3<T>& vel_cmd, T yaw_rate_cmd, T period)
+  {
+    Vec3<T> rpy = quatToRPY(state.quat_).template cast<T>();
+    if (!initialized_)
+    {
+      pos_des_ = state.pos_.head(2).template cast<T>();
+      yaw_des_ = rpy(2);
+      initialized_ = true;
+    }
+    vel_cmd_ = vel_cmd.head(2);
+    yaw_rate_cmd_ = yaw_rate_cmd;
+
+    pos_des_ += yawRotation(yaw_des_) * vel_cmd_ * period;
+    yaw_des_ += yaw_rate_cmd_ * period;
+
+    // Keep the desired pose close to the robot, avoid winding up when it can not follow the command
+    for (int i = 0; i < 2; ++i)
+      pos_des_(i) =
+          std::min(std::max(pos_des_(i), T(state.pos_(i)) - max_pos_error_), T(state.pos_(i)) + max_pos_error_);
+    // Keep the same branch as the yaw of quatToRPY() which is used as the initial state of the mpc
+    yaw_des_ = rpy(2) + std::remainder(yaw_des_ - rpy(2), 2. * M_PI);
+  }
+
+  /*!
+   * Fill the reference of every step over the horizon, traj should already have the size of 12 * horizon
+   * @param horizon : the horizon of the mpc
+   * @param dt : the time step of the mpc
+   * @param lead : start the horizon this long after now, with the pose extrapolated by the command
+   */
+  void fill(int horizon, T dt, DVec<T>& traj, T lead = 0.) const
+  {
+    T yaw = yaw_des_ + yaw_rate_cmd_ * lead;
+    Vec2<T> pos = pos_des_ + yawRotation(yaw_des_) * vel_cmd_ * lead;
+    for (int i = 0; i < horizon; ++i)
+    {
+      Vec2<T> vel = yawRotation(yaw) * vel_cmd_;
+      pos += vel * dt;
+      yaw += yaw_rate_cmd_ * dt;
+      T* step = traj.data() + 12 * i;
+      step[0] = 0.;
+      step[1] = 0.;
+      step[2] = yaw;
+      step[3] = pos(0);
+      step[4] = pos(1);
+      step[5] = height_;
+      step[6] = 0.;
+      step[7] = 0.;
+      step[8] = yaw_rate_cmd_;
+      step[9] = vel(0);
+      step[10] = vel(1);
+      step[11] = 0.;
+    }
+  }
+
+  // The commanded linear velocity in world frame
+  Vec3<T> getLinearVel() const
+  {
+    Vec3<T> vel;
+    vel << yawRotation(yaw_des_) * vel_cmd_, 0.;
+    return vel;
+  }
+
+  T getYawRate() const
+  {
+    return yaw_rate_cmd_;
+  }
+
+  void reset()
+  {
+    initialized_ = false;
+  }
+
+private:
+  static Eigen::Matrix<T, 2, 2> yawRotation(T yaw)
+  {
+    Eigen::Matrix<T, 2, 2> r;
+    r << std::cos(yaw), -std::sin(yaw), std::sin(yaw), std::cos(yaw);
+    return r;
+  }
+
+  T height_, max_pos_error_;
+  bool initialized_{ false };
+  Vec2<T> pos_des_, vel_cmd_;
+  T yaw_des_{}, yaw_rate_cmd_{};
+};
+
+}  // namespace cheetah_ros
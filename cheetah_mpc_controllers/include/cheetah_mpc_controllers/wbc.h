@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cheetah_common/cpp_types.h>
+
+#include <Eigen/Dense>
+#include <qpOASES.hpp>
+
+namespace cheetah_ros
+{
+/*!
+ * Weighted whole body control, refer to the WBC of MIT Cheetah-Software. The decision variables are the generalized
+ * acceleration and the ground reaction forces x = [qdd, f], subject to the floating base dynamics, no acceleration of
+ * the stance feet and the friction cone. The QP has a fixed size so that it can be hot started every tick.
+ */
+class Wbc
+{
+public:
+  static constexpr int NV = 18;              // Floating base + 12 joints
+  static constexpr int NX = NV + 12;         // qdd + ground reaction forces
+  static constexpr int NC = 6 + 12 + 4 * 5;  // Floating base dynamics + stance feet acceleration + friction cone
+  const double BIG_VALUE = 1e10;
+
+  using MatM = Eigen::Matrix<double, NV, NV>;
+  using MatJ = Eigen::Matrix<double, 12, NV>;
+
+  Wbc(double mu, double force_weight, double swing_weight, double reg_weight);
+
+  /*!
+   * Solve the QP and compute the joint torques
+   * @param m : joint space inertia matrix (full, not only the upper triangle)
+   * @param h : nonlinear effects (coriolis, centrifugal and gravity)
+   * @param j : jacobians of the four feet (translation part, LOCAL_WORLD_ALIGNED)
+   * @param jdot_v : classical acceleration of the feet at zero joint acceleration
+   * @param contact : whether the foot is in stance
+   * @param foot_force : desired cartesian force which the foot applies (the same as ControllerBase)
+   * @param tau : output torques of the 12 joints
+   * @return : false if the QP failed, tau is not modified
+   */
+  bool update(const MatM& m, const Vec18<double>& h, const MatJ& j, const Vec12<double>& jdot_v, const bool contact[4],
+              const Vec12<double>& foot_force, Vec12<double>& tau);
+
+private:
+  double mu_, force_weight_, swing_weight_, reg_weight_;
+
+  qpOASES::SQProblem qp_;
+  bool hot_start_;
+
+  Eigen::Matrix<double, NX, NX, Eigen::RowMajor> h_qp_;
+  Eigen::Matrix<double, NC, NX, Eigen::RowMajor> a_qp_;
+  Eigen::Matrix<double, NX, 1> g_qp_, lb_, ub_, x_;
+  Eigen::Matrix<double, NC, 1> lb_a_, ub_a_;
+  Eigen::LLT<MatM> m_llt_;
+  Eigen::Matrix<double, NV, 12> m_inv_jt_;
+};
+
+}  // namespace cheetah_ros
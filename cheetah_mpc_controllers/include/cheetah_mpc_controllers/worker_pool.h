@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cheetah_ros
+{
+/*!
+ * Persistent threads which run the tasks of a batch in parallel, so that no thread is created per solve.
+ */
+class WorkerPool
+{
+public:
+  // With zero thread, the tasks run on the calling thread
+  explicit WorkerPool(int num_threads)
+  {
+    for (int i = 0; i < num_threads; ++i)
+      threads_.emplace_back(&WorkerPool::worker, this);
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stop_ = true;
+    }
+    cv_task_.notify_all();
+    for (auto& thread : threads_)
+      thread.join();
+  }
+
+  // Run task(i) for i in [0, n) and wait until all of them are finished, should be called from one thread at a time
+  void run(int n, const std::function<void(int)>& task)
+  {
+    if (threads_.empty())
+    {
+      for (int i = 0; i < n; ++i)
+        task(i);
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    n_ = n;
+    next_ = 0;
+    done_ = 0;
+    cv_task_.notify_all();
+    cv_done_.wait(lock, [this] { return done_ == n_; });
+    task_ = nullptr;
+  }
+
+  int size() const
+  {
+    return threads_.size();
+  }
+
+private:
+  void worker()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      cv_task_.wait(lock, [this] { return stop_ || next_ < n_; });
+      if (stop_)
+        return;
+      int i = next_++;
+      lock.unlock();
+      (*task_)(i);
+      lock.lock();
+      if (++done_ == n_)
+        cv_done_.notify_all();
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cv_task_, cv_done_;
+  const std::function<void(int)>* task_{ nullptr };
+  int n_{}, next_{}, done_{};
+  bool stop_{ false };
+};
+
+}  // namespace cheetah_ros
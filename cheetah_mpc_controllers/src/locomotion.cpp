@@ -17,39 +17,201 @@ bool LocomotionBase::init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle
   for (auto gait_params : gaits_params)
     name2gaits_.insert(
         std::make_pair(gait_params.first.c_str(), std::make_shared<OffsetDurationGaitRos<double>>(gait_params.second)));
-  gait_ = name2gaits_.begin()->second;
+  std::string default_gait = getParam<std::string>(controller_nh, "default_gait", name2gaits_.begin()->first);
+  if (name2gaits_.find(default_gait) == name2gaits_.end())
+  {
+    ROS_ERROR_STREAM("Default gait " << default_gait << " is not defined in gaits");
+    return false;
+  }
+  gait_ = name2gaits_[default_gait];
+  gait_buffer_.initRT(gait_);
+
+  gait_confidence_ = getParam(controller_nh, "contact/gait_confidence", 0.8);
+  table_.resize(4 * solver_->getHorizon());
+  next_table_.resize(4 * solver_->getHorizon());
+
+  // Reference trajectory
+  XmlRpc::XmlRpcValue traj_params;
+  controller_nh.getParam("traj", traj_params);
+  vel_reference_ = std::make_shared<VelocityReference<double>>(xmlRpcGetDouble(traj_params, "height", 0.1),
+                                                               xmlRpcGetDouble(traj_params, "max_pos_error", 0.1));
+  vel_cmd_timeout_ = xmlRpcGetDouble(traj_params, "cmd_vel_timeout", 0.5);
+  ref_traj_.resize(12 * solver_->getHorizon());
+  ref_traj_.setZero();
+
+  // Footstep
+  XmlRpc::XmlRpcValue footstep_params;
+  controller_nh.getParam("footstep", footstep_params);
+  footstep_planner_ = std::make_shared<RaibertFootstepPlanner<double>>(
+      xmlRpcGetDouble(footstep_params, "k_vel", 0.03), xmlRpcGetDouble(footstep_params, "max_offset", 0.3));
+  swing_height_ = xmlRpcGetDouble(footstep_params, "swing_height", 0.05);
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    if (!pin_model_->existFrame(robot_description_.getHipName(leg)))
+    {
+      ROS_ERROR_STREAM("Can not find the hip " << robot_description_.getHipName(leg) << " in the urdf");
+      return false;
+    }
+    hip_frame_ids_[leg] = pin_model_->getFrameId(robot_description_.getHipName(leg));
+    // The second joint of the leg (thigh) is where the hip offset of the unitree legs ends
+    pinocchio::JointIndex thigh_id = pin_model_->getJointId(robot_description_.getJointName(leg * 3 + 1));
+    hip_offsets_[leg] = pin_model_->jointPlacements[thigh_id].translation();
+  }
 
+  // ROS Topic
+  gait_cmd_sub_ =
+      controller_nh.subscribe<std_msgs::String>("/cmd_gait", 1, &LocomotionBase::gaitCmdCallback, this);
+  vel_cmd_sub_ =
+      controller_nh.subscribe<geometry_msgs::Twist>("/cmd_vel", 1, &LocomotionBase::velCmdCallback, this);
   return true;
 }
 
+void LocomotionBase::starting(const ros::Time& time)
+{
+  vel_reference_->reset();  // Hold the current pose
+}
+
 void LocomotionBase::updateCommand(const ros::Time& time, const ros::Duration& period)
 {
-  Eigen::VectorXd traj;
-  traj.resize(12 * horizon_);
-  traj.setZero();
-  for (int i = 0; i < horizon_; ++i)
-    traj[12 * i + 5] = 0.1;
-  setTraj(traj);
+  updateTraj(time, period);
+  updateGait(time);
+  setGaitTable(table_);
+  for (int leg = 0; leg < 4; ++leg)
+    contact_expectation_[leg] = table_[leg] == 1 ? gait_confidence_ : 1. - gait_confidence_;
+  updateFootstep();
+  updateNextStep(time);
+
+  MpcController::updateCommand(time, period);
+}
+
+bool LocomotionBase::setGait(const std::string& name)
+{
+  auto gait = name2gaits_.find(name);
+  if (gait == name2gaits_.end())
+  {
+    ROS_WARN_STREAM("Gait " << name << " is not defined");
+    return false;
+  }
+  gait_buffer_.writeFromNonRT(gait->second);
+  return true;
+}
+
+void LocomotionBase::updateGait(const ros::Time& time)
+{
+  int horizon = solver_->getHorizon();
+  if (table_.size() != 4 * horizon)  // Only when the horizon is reconfigured
+  {
+    table_.resize(4 * horizon);
+    next_table_.resize(4 * horizon);
+    if (next_gait_ != nullptr)
+      next_gait_->getMpcTable(horizon, 0., next_table_);
+  }
+
+  const OffsetDurationGaitRos<double>::Ptr& request = *gait_buffer_.readFromRT();
+  if (request != gait_ && request != next_gait_)
+  {
+    next_gait_ = request;
+    // Stage the first cycle of the next gait, it is spliced into the tail of the horizon
+    next_gait_->getMpcTable(horizon, 0., next_table_);
+  }
+  else if (request == gait_)  // Cancel a pending switch
+    next_gait_ = nullptr;
 
   gait_->update(time);
-  Eigen::VectorXd table = gait_->getMpcTable(solver_->getHorizon());
-  setGaitTable(table);
+  double phase = gait_->getPhase();
+  if (next_gait_ != nullptr && phase < last_phase_)
+  {
+    // The current cycle just ended, start the next gait at the boundary so that both gaits are in phase
+    ros::Time boundary = time - ros::Duration(phase * gait_->getCycle());
+    gait_ = next_gait_;
+    next_gait_ = nullptr;
+    gait_->setStartTime(boundary);
+    gait_->update(time);
+    phase = gait_->getPhase();
+  }
+  last_phase_ = phase;
+
+  gait_->getMpcTable(horizon, phase, table_);
+  if (next_gait_ != nullptr)
+  {
+    // Let the mpc see the contact sequence of the next gait after the end of the current cycle
+    int remain = horizon - static_cast<int>(phase * horizon);
+    table_.tail(4 * (horizon - remain)) = next_table_.head(4 * (horizon - remain));
+  }
+}
+
+void LocomotionBase::updateTraj(const ros::Time& time, const ros::Duration& period)
+{
+  const VelCmd& cmd = *vel_cmd_buffer_.readFromRT();
+  if (vel_cmd_timeout_ > 0. && (time - cmd.stamp_).toSec() > vel_cmd_timeout_)
+    vel_reference_->update(robot_state_, Vec3<double>::Zero(), 0., period.toSec());
+  else
+    vel_reference_->update(robot_state_, Vec3<double>(cmd.twist_.linear.x, cmd.twist_.linear.y, 0.),
+                           cmd.twist_.angular.z, period.toSec());
+  int horizon = solver_->getHorizon();
+  if (ref_traj_.size() != 12 * horizon)  // Only when the horizon is reconfigured
+    ref_traj_.resize(12 * horizon);
+  vel_reference_->fill(horizon, solver_->getDt(), ref_traj_);
+  setTraj(ref_traj_);
+}
+
+void LocomotionBase::updateFootstep()
+{
   Vec4<double> swing_time = gait_->getSwingTime();
-  double sign_fr[4] = { 1.0, 1.0, -1.0, -1.0 };
-  double sign_lr[4] = { 1.0, -1.0, 1.0, -1.0 };
+  Vec4<double> stance_time = gait_->getStanceTime();
+  Vec3<double> vel_cmd = vel_reference_->getLinearVel();
+  Matrix3d rot = robot_state_.quat_.toRotationMatrix();
 
   for (int i = 0; i < 4; ++i)
   {
     LegPrefix leg = LegPrefix(i);
-    if (table[i] == 0 && getFootState(leg) == STAND)
-    {
-      Eigen::Vector3d pos;
-      pos << sign_fr[i] * 0.25, sign_lr[i] * 0.15, 0.;  // TODO footstep
-      setSwing(leg, pos, 0.05, swing_time[i]);
-    }
+    bool lift_off = table_[i] == 0 && getFootState(leg) == STAND;
+    if (!lift_off && getFootState(leg) != SWING)
+      continue;
+    // The hip position is already updated by ControllerBase::pinocchioKine()
+    Vector3d hip_pos = pin_data_->oMf[hip_frame_ids_[i]].translation() + rot * hip_offsets_[i];
+    double time_to_touchdown = lift_off ? swing_time[i] : getSwingRemainTime(leg);
+    Vector3d pos = footstep_planner_->plan(robot_state_.pos_, hip_pos, robot_state_.linear_vel_, vel_cmd,
+                                           vel_reference_->getYawRate(), stance_time[i], time_to_touchdown);
+    if (lift_off)
+      setSwing(leg, pos, swing_height_, swing_time[i]);
+    else
+      setSwingFinalPosition(leg, pos);
   }
+}
 
-  MpcController::updateCommand(time, period);
+void LocomotionBase::updateNextStep(const ros::Time& time)
+{
+  if (!step_aligned_)
+    return;
+  int horizon = solver_->getHorizon();
+  if (next_step_table_.size() != 4 * horizon)  // Only when the horizon is reconfigured
+  {
+    next_step_table_.resize(4 * horizon);
+    next_step_traj_.resize(12 * horizon);
+  }
+
+  double step_duration = gait_->getCycle() / horizon;
+  double progress = gait_->getPhase() * horizon;
+  double to_boundary = (std::floor(progress) + 1. - progress) * step_duration;
+  // The table is periodic, shift it by one step. With a pending switch, the new last step is from the next gait.
+  next_step_table_.head(4 * (horizon - 1)) = table_.tail(4 * (horizon - 1));
+  if (next_gait_ != nullptr)
+    next_step_table_.tail(4) = next_table_.segment(4 * static_cast<int>(progress), 4);
+  else
+    next_step_table_.tail(4) = table_.head(4);
+  vel_reference_->fill(horizon, solver_->getDt(), next_step_traj_, to_boundary);
+  setNextStep(time + ros::Duration(to_boundary), step_duration, next_step_table_, next_step_traj_);
+}
+
+void LocomotionBase::gaitCmdCallback(const std_msgs::String::ConstPtr& msg)
+{
+  setGait(msg->data);
+}
+
+void LocomotionBase::velCmdCallback(const geometry_msgs::Twist::ConstPtr& msg)
+{
+  vel_cmd_buffer_.writeFromNonRT(VelCmd{ *msg, ros::Time::now() });
 }
 
 }  // namespace cheetah_ros
@@ -0,0 +1,51 @@
+#include "cheetah_mpc_controllers/mpc_batch.h"
+
+namespace cheetah_ros
+{
+MpcBatchEvaluator::MpcBatchEvaluator(double mass, double gravity, double mu, const Matrix3d& inertia, double f_max,
+                                     int num_threads)
+  : mass_(mass)
+  , gravity_(gravity)
+  , mu_(mu)
+  , f_max_(f_max)
+  , inertia_(inertia)
+  , pool_(num_threads < 0 ? std::thread::hardware_concurrency() : num_threads)
+{
+}
+
+void MpcBatchEvaluator::evaluate(const MpcCases& cases, std::vector<MpcResult>& results)
+{
+  results.resize(cases.size());
+  pool_.run(cases.size(), [&](int i) { results[i] = evaluate(cases[i], mass_, gravity_, mu_, inertia_, f_max_); });
+}
+
+MpcResult MpcBatchEvaluator::evaluate(const MpcCase& mpc_case, double mass, double gravity, double mu,
+                                      const Matrix3d& inertia, double f_max)
+{
+  MpcResult result{};
+  auto start = std::chrono::steady_clock::now();
+  if (mpc_case.gait_table_.size() != 4 * mpc_case.horizon_ || mpc_case.traj_.size() != 12 * mpc_case.horizon_)
+    return result;
+
+  // The same steps as MpcSolverBase::formulate()
+  QpOasesSolver::Formulation formulation;
+  RobotStateTpl<ControlScalar> state = mpc_case.state_.cast<ControlScalar>();
+  formulation.setup(mpc_case.horizon_, mpc_case.weight_.cast<ControlScalar>(), mpc_case.alpha_, 1.);
+  formulation.buildStateSpace(mass, inertia.cast<ControlScalar>(), state);
+  formulation.buildQp(mpc_case.dt_);
+  formulation.buildHessianMat();
+  formulation.buildGVec(gravity, state, mpc_case.traj_);
+  formulation.buildConstrainMat(mu);
+  formulation.buildConstrainUpperBound(f_max, mpc_case.gait_table_);
+  formulation.buildConstrainLowerBound();
+
+  std::vector<qpOASES::real_t> sol(12 * mpc_case.horizon_, 0);
+  result.feasible_ = QpOasesSolver::solveQp(formulation, formulation.a_.data(), sol.data(), result.cost_);
+  if (result.feasible_)
+    for (int leg = 0; leg < 4; ++leg)
+      result.force_[leg] << sol[3 * leg], sol[3 * leg + 1], sol[3 * leg + 2];
+  result.solve_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+}  // namespace cheetah_ros
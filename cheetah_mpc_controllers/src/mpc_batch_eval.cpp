@@ -0,0 +1,100 @@
+#include <cheetah_mpc_controllers/mpc_batch.h>
+#include <cheetah_common/math_utilities.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace cheetah_ros;
+
+/*
+ * Usage: mpc_batch_eval <cases> [mass ixx iyy izz mu f_max [threads]]
+ * Each line of the cases file is one problem, numbers separated by spaces, lines starting with # are skipped:
+ *   horizon dt alpha weight(12) pos(3) rpy(3) angular_vel(3) linear_vel(3) foot_pos(12) gait_table(4*horizon)
+ *   traj(12*horizon)
+ * Print one line per problem: index feasible cost force(12) solve_time
+ */
+int main(int argc, char** argv)
+{
+  if (argc != 2 && argc != 8 && argc != 9)
+  {
+    std::cerr << "Usage: " << argv[0] << " <cases> [mass ixx iyy izz mu f_max [threads]]" << std::endl;
+    return 1;
+  }
+  double mass = 11.041, mu = 0.6, f_max = 200.;
+  Matrix3d inertia;
+  inertia << 0.050874, 0., 0., 0., 0.64036, 0., 0., 0., 0.6565;
+  int threads = -1;
+  if (argc >= 8)
+  {
+    mass = std::stod(argv[2]);
+    inertia.diagonal() << std::stod(argv[3]), std::stod(argv[4]), std::stod(argv[5]);
+    mu = std::stod(argv[6]);
+    f_max = std::stod(argv[7]);
+  }
+  if (argc == 9)
+    threads = std::stoi(argv[8]);
+
+  std::ifstream file(argv[1]);
+  if (!file)
+  {
+    std::cerr << "Can not open " << argv[1] << std::endl;
+    return 1;
+  }
+  MpcCases cases;
+  std::string line;
+  for (int line_num = 1; std::getline(file, line); ++line_num)
+  {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream stream(line);
+    MpcCase mpc_case;
+    Vector3d rpy;
+    stream >> mpc_case.horizon_ >> mpc_case.dt_ >> mpc_case.alpha_;
+    for (int i = 0; i < 12; ++i)
+      stream >> mpc_case.weight_(i);
+    mpc_case.weight_(12) = 0.;
+    stream >> mpc_case.state_.pos_(0) >> mpc_case.state_.pos_(1) >> mpc_case.state_.pos_(2);
+    stream >> rpy(0) >> rpy(1) >> rpy(2);
+    mpc_case.state_.quat_ = RpyToQuat(rpy);
+    for (int i = 0; i < 3; ++i)
+      stream >> mpc_case.state_.angular_vel_(i);
+    for (int i = 0; i < 3; ++i)
+      stream >> mpc_case.state_.linear_vel_(i);
+    for (auto& foot_pos : mpc_case.state_.foot_pos_)
+      stream >> foot_pos(0) >> foot_pos(1) >> foot_pos(2);
+    if (!stream || mpc_case.horizon_ <= 0)
+    {
+      std::cerr << "Bad case at line " << line_num << std::endl;
+      return 1;
+    }
+    mpc_case.gait_table_.resize(4 * mpc_case.horizon_);
+    for (int i = 0; i < mpc_case.gait_table_.size(); ++i)
+      stream >> mpc_case.gait_table_(i);
+    mpc_case.traj_.resize(12 * mpc_case.horizon_);
+    for (int i = 0; i < mpc_case.traj_.size(); ++i)
+      stream >> mpc_case.traj_(i);
+    if (!stream)
+    {
+      std::cerr << "Bad case at line " << line_num << std::endl;
+      return 1;
+    }
+    cases.push_back(mpc_case);
+  }
+
+  MpcBatchEvaluator evaluator(mass, -9.81, mu, inertia, f_max, threads);
+  std::vector<MpcResult> results;
+  auto start = std::chrono::steady_clock::now();
+  evaluator.evaluate(cases, results);
+  double spend = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    std::cout << i << " " << results[i].feasible_ << " " << results[i].cost_;
+    for (const auto& force : results[i].force_)
+      std::cout << " " << force.x() << " " << force.y() << " " << force.z();
+    std::cout << " " << results[i].solve_time_ << "\n";
+  }
+  std::cerr << results.size() << " cases spend " << spend << " second" << std::endl;
+  return 0;
+}
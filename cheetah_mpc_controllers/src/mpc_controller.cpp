@@ -3,6 +3,14 @@
 //
 #include "cheetah_mpc_controllers/mpc_controller.h"
 
+#include <pinocchio/algorithm/joint-configuration.hpp>
+#include <pinocchio/algorithm/centroidal.hpp>
+#include <pinocchio/algorithm/crba.hpp>
+#include <pinocchio/algorithm/rnea.hpp>
+#include <pinocchio/algorithm/kinematics.hpp>
+#include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/jacobian.hpp>
+
 #include <pluginlib/class_list_macros.hpp>
 
 namespace cheetah_ros
@@ -43,13 +51,65 @@ bool MpcController::init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle&
   else
     dynamic_initialized_ = true;
 
-  // TODO: Add interface
-  //  double mass = 22.5; Gazebo
-  double mass = 22.5;
+  double mass, gravity;
   Matrix3d inertia;
-  inertia << 0.050874, 0., 0., 0., 0.64036, 0., 0., 0., 0.6565;
+  if (!initInertial(mpc_params, mass, inertia, gravity))
+    return false;
+  double mu = xmlRpcGetDouble(mpc_params, "mu", 0.6);
+  ROS_INFO_STREAM("[Mpc] mass: " << mass << " gravity: " << gravity << " mu: " << mu << " inertia:\n" << inertia);
+
+  if (mpc_params.hasMember("hypotheses"))
+  {
+    // Extra friction coefficients solved in parallel with the nominal one
+    XmlRpc::XmlRpcValue& hypotheses_params = mpc_params["hypotheses"];
+    if (hypotheses_params["mu"].getType() != XmlRpc::XmlRpcValue::TypeArray ||
+        (hypotheses_params.hasMember("penalty") &&
+         hypotheses_params["penalty"].size() != hypotheses_params["mu"].size()))
+    {
+      ROS_ERROR("[Mpc] hypotheses/mu should be an array with the same size as hypotheses/penalty");
+      return false;
+    }
+    std::vector<MultiHypothesisSolver::Hypothesis> hypotheses;
+    for (int i = 0; i < hypotheses_params["mu"].size(); ++i)
+      hypotheses.push_back(MultiHypothesisSolver::Hypothesis{
+          xmlRpcGetDouble(hypotheses_params["mu"], i),
+          hypotheses_params.hasMember("penalty") ? xmlRpcGetDouble(hypotheses_params["penalty"], i) : 0. });
+    // The solving thread itself takes one core
+    int num_threads = std::min(static_cast<int>(hypotheses.size()) + 1,
+                               std::max(static_cast<int>(std::thread::hardware_concurrency()) - 2, 0));
+    if (hypotheses_params.hasMember("threads"))
+      num_threads = hypotheses_params["threads"];
+    ROS_INFO_STREAM("[Mpc] " << hypotheses.size() + 1 << " hypotheses on " << num_threads << " threads");
+    solver_ = std::make_shared<MultiHypothesisSolver>(
+        mass, gravity, mu, inertia, hypotheses, xmlRpcGetDouble(hypotheses_params, "nominal_penalty", 0.),
+        xmlRpcGetDouble(hypotheses_params, "cost_tolerance", 0.05), num_threads);
+  }
+  else
+    solver_ = std::make_shared<QpOasesSolver>(mass, gravity, mu, inertia);
+  solver_->setDelayCompensation(mpc_params.hasMember("delay_compensation") &&
+                                static_cast<bool>(mpc_params["delay_compensation"]));
 
-  solver_ = std::make_shared<QpOasesSolver>(mass, -9.81, 0.6, inertia);
+  update_inertia_ = mpc_params.hasMember("update_inertia") && static_cast<bool>(mpc_params["update_inertia"]);
+  if (update_inertia_ && mpc_params.hasMember("inertia"))
+  {
+    // The configured inertia replaces the one of the urdf, it is not refreshed from the joints
+    ROS_WARN("[Mpc] inertia is configured, update_inertia is ignored");
+    update_inertia_ = false;
+  }
+  inertia_threshold_ = xmlRpcGetDouble(mpc_params, "inertia_threshold", 0.05);
+  pin_data_inertia_ = std::make_shared<pinocchio::Data>(*pin_model_);
+
+  XmlRpc::XmlRpcValue wbc_params;
+  if (controller_nh.getParam("wbc", wbc_params) && wbc_params.hasMember("enable") &&
+      static_cast<bool>(wbc_params["enable"]))
+  {
+    wbc_ = std::make_shared<Wbc>(mu, xmlRpcGetDouble(wbc_params, "force_weight", 1.),
+                                 xmlRpcGetDouble(wbc_params, "swing_weight", 1.),
+                                 xmlRpcGetDouble(wbc_params, "reg_weight", 1e-4));
+    pin_data_wbc_ = std::make_shared<pinocchio::Data>(*pin_model_);
+    wbc_a_ = VectorXd::Zero(pin_model_->nv);
+    ROS_INFO("[Mpc] Whole body control enabled");
+  }
 
   // Dynamic reconfigure
   ros::NodeHandle nh_mpc = ros::NodeHandle(controller_nh, "mpc");
@@ -59,16 +119,188 @@ bool MpcController::init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle&
   };
   dynamic_srv_->setCallback(cb);
 
-  traj_.resize(12 * horizon_);
+  traj_.resize(12 * solver_->getHorizon());
   traj_.setZero();
 
+  step_aligned_ = mpc_params.hasMember("step_aligned") && static_cast<bool>(mpc_params["step_aligned"]);
+  lead_margin_ = xmlRpcGetDouble(mpc_params, "lead_margin", 0.002);
+
+  XmlRpc::XmlRpcValue adaptive_params;
+  adaptive_horizon_ = controller_nh.getParam("mpc/adaptive", adaptive_params) &&
+                      adaptive_params.hasMember("enable") && static_cast<bool>(adaptive_params["enable"]);
+  if (adaptive_horizon_)
+  {
+    deadline_ = xmlRpcGetDouble(adaptive_params, "deadline", solver_->getDt());
+    grow_ratio_ = xmlRpcGetDouble(adaptive_params, "grow_ratio", 0.5);
+    min_horizon_ = adaptive_params.hasMember("min_horizon") ? static_cast<int>(adaptive_params["min_horizon"]) : 5;
+    max_horizon_ = adaptive_params.hasMember("max_horizon") ? static_cast<int>(adaptive_params["max_horizon"]) :
+                                                              solver_->getHorizon();
+    window_ = adaptive_params.hasMember("window") ? static_cast<int>(adaptive_params["window"]) : 20;
+    ROS_INFO_STREAM("[Mpc] Adaptive horizon in [" << min_horizon_ << ", " << max_horizon_
+                                                  << "], deadline: " << deadline_);
+  }
+
+  diag_pub_ = std::make_shared<realtime_tools::RealtimePublisher<diagnostic_msgs::DiagnosticArray>>(
+      controller_nh, "/diagnostics", 10);
+  diag_pub_->msg_.status.resize(1);
+  diag_pub_->msg_.status[0].name = "mpc";
+  diag_pub_->msg_.status[0].hardware_id = "locomotion_controller";
+  diag_pub_->msg_.status[0].message.reserve(REALTIME_STRING_CAPACITY);
+  const char* keys[] = { "horizon",        "dt",           "solve_time_mean", "solve_time_p50",
+                         "solve_time_p95", "solve_time_max", "timeouts" };
+  for (const char* key : keys)
+  {
+    // Reserve in place, a copy of the value would not keep the capacity
+    diag_pub_->msg_.status[0].values.emplace_back();
+    diag_pub_->msg_.status[0].values.back().key = key;
+    diag_pub_->msg_.status[0].values.back().value.reserve(REALTIME_STRING_CAPACITY);
+  }
+
   return true;
 }
 
+bool MpcController::initInertial(XmlRpc::XmlRpcValue& mpc_params, double& mass, Matrix3d& inertia, double& gravity)
+{
+  // Composite rigid body inertia of the whole robot in the nominal configuration, expressed at the CoM
+  Eigen::VectorXd q = pinocchio::neutral(*pin_model_);
+  Eigen::VectorXd v = Eigen::VectorXd::Zero(pin_model_->nv);
+  if (mpc_params.hasMember("nominal_joint_pos"))
+  {
+    if (mpc_params["nominal_joint_pos"].getType() != XmlRpc::XmlRpcValue::TypeArray ||
+        mpc_params["nominal_joint_pos"].size() != 3)
+    {
+      ROS_ERROR("[Mpc] nominal_joint_pos should be [hip, thigh, calf]");
+      return false;
+    }
+    for (int leg = 0; leg < 4; ++leg)
+      for (int joint = 0; joint < 3; ++joint)
+        q(q_index_[leg * 3 + joint]) = xmlRpcGetDouble(mpc_params["nominal_joint_pos"], joint);
+  }
+  pinocchio::ccrba(*pin_model_, *pin_data_, q, v);
+  mass = pin_data_->Ig.mass();
+  inertia = pin_data_->Ig.inertia().matrix();
+  inertia_q_ = q;
+  inertia_v_ = v;
+  gravity = pin_model_->gravity.linear().z();
+
+  // Per-robot overrides
+  mass = xmlRpcGetDouble(mpc_params, "mass", mass);
+  gravity = xmlRpcGetDouble(mpc_params, "gravity", gravity);
+  if (mpc_params.hasMember("inertia"))
+  {
+    if (mpc_params["inertia"].getType() != XmlRpc::XmlRpcValue::TypeArray || mpc_params["inertia"].size() != 3)
+    {
+      ROS_ERROR("[Mpc] inertia should be the diagonal [ixx, iyy, izz]");
+      return false;
+    }
+    inertia.setZero();
+    for (int i = 0; i < 3; ++i)
+      inertia(i, i) = xmlRpcGetDouble(mpc_params["inertia"], i);
+  }
+  return true;
+}
+
+void MpcController::updateInertia(const ros::Time& time)
+{
+  if (time < last_inertia_update_)  // Simulation reset
+    last_inertia_update_ = time;
+  if (!update_inertia_ || time - last_inertia_update_ < ros::Duration(solver_->getDt()))
+    return;
+  last_inertia_update_ = time;
+
+  double max_change = 0.;
+  for (int leg = 0; leg < 4; ++leg)
+    for (int joint = 0; joint < 3; ++joint)
+    {
+      double pos = getLegJoints(LegPrefix(leg)).joints_[joint].getPosition();
+      max_change = std::max(max_change, std::abs(pos - inertia_q_(q_index_[leg * 3 + joint])));
+    }
+  if (max_change < inertia_threshold_)
+    return;
+
+  // The base stays at the origin, the formulation rotates the inertia by yaw itself
+  for (int leg = 0; leg < 4; ++leg)
+    for (int joint = 0; joint < 3; ++joint)
+      inertia_q_(q_index_[leg * 3 + joint]) = getLegJoints(LegPrefix(leg)).joints_[joint].getPosition();
+  pinocchio::ccrba(*pin_model_, *pin_data_inertia_, inertia_q_, inertia_v_);
+  solver_->setInertia(pin_data_inertia_->Ig.inertia().matrix());
+}
+
+void MpcController::launchStep(const ros::Time& time)
+{
+  if (step_duration_ <= 0. || std::abs((step_boundary_ - launched_boundary_).toSec()) < step_duration_ / 2)
+    return;  // No step is set or it is already launched
+  const MpcSolverBase::Statistics& statistics = solver_->getStatistics();
+  ros::Duration lead(lead_margin_ + (statistics.count_ > 0 ? statistics.p95_ : 0.));
+  if (time < step_boundary_ - lead)
+    return;
+  if (solver_->launch(time, step_boundary_, robot_state_, step_table_, step_traj_))
+    launched_boundary_ = step_boundary_;
+}
+
+void MpcController::updateHorizon()
+{
+  const MpcSolverBase::Statistics& statistics = solver_->getStatistics();
+  bool timeout = statistics.timeouts_ != last_timeouts_;
+  last_timeouts_ = statistics.timeouts_;
+  int horizon = solver_->getHorizon();
+  if (!adaptive_horizon_ || horizon == 0 || (statistics.count_ < window_ && !timeout))
+    return;
+
+  int next = horizon;
+  if (timeout || statistics.p95_ > deadline_)
+    next = std::max(horizon - 1, min_horizon_);
+  else if (statistics.p95_ < grow_ratio_ * deadline_)
+    next = std::min(horizon + 1, max_horizon_);
+  // Repeated requests before the new horizon takes effect are ignored by the solver
+  if (next != horizon)
+    solver_->setHorizon(next, solver_->getDt() * horizon / next, 1.);
+}
+
+void MpcController::publishDiagnostics(const ros::Time& time)
+{
+  if (time < last_diag_)  // Simulation reset
+    last_diag_ = time;
+  if (time - last_diag_ < ros::Duration(1.))
+    return;
+  if (diag_pub_->trylock())
+  {
+    last_diag_ = time;
+    const MpcSolverBase::Statistics& statistics = solver_->getStatistics();
+    diagnostic_msgs::DiagnosticStatus& status = diag_pub_->msg_.status[0];
+    if (statistics.p95_ > (adaptive_horizon_ ? deadline_ : solver_->getDt()))
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "Solve time exceeds the deadline";
+    }
+    else
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "OK";
+    }
+    // Filled in the update of the controller, so the strings are reused instead of allocated
+    formatNumber(status.values[0].value, solver_->getHorizon());
+    formatNumber(status.values[1].value, solver_->getDt());
+    formatNumber(status.values[2].value, statistics.mean_);
+    formatNumber(status.values[3].value, statistics.p50_);
+    formatNumber(status.values[4].value, statistics.p95_);
+    formatNumber(status.values[5].value, statistics.max_);
+    formatNumber(status.values[6].value, statistics.timeouts_);
+    diag_pub_->msg_.header.stamp = time;
+    diag_pub_->unlockAndPublish();
+  }
+}
+
 void MpcController::updateCommand(const ros::Time& time, const ros::Duration& period)
 {
-  solver_->solve(time, robot_state_, gait_table_, traj_);
-  std::vector<Vec3<double>> solution = solver_->getSolution();
+  updateInertia(time);
+  if (step_aligned_)
+    launchStep(time);
+  else
+    solver_->solve(time, robot_state_, gait_table_, traj_);
+  updateHorizon();
+  publishDiagnostics(time);
+  const std::vector<Vec3<double>>& solution = solver_->getSolution(time);
   for (int i = 0; i < 4; ++i)
     if (gait_table_[i] == 1)
       setStand(LegPrefix(i), solution[i]);
@@ -76,6 +308,52 @@ void MpcController::updateCommand(const ros::Time& time, const ros::Duration& pe
   FeetController::updateCommand(time, period);
 }
 
+void MpcController::updateJointTorque(const Eigen::Vector3d (&foot_force)[4])
+{
+  if (wbc_ == nullptr)
+  {
+    ControllerBase::updateJointTorque(foot_force);
+    return;
+  }
+
+  pinocchio::Data& data = *pin_data_wbc_;
+  pinocchio::crba(*pin_model_, data, pin_q_);
+  data.M.triangularView<Eigen::StrictlyLower>() = data.M.transpose().triangularView<Eigen::StrictlyLower>();
+  wbc_m_ = data.M;
+  wbc_h_ = pinocchio::nonLinearEffects(*pin_model_, data, pin_q_, pin_v_);
+
+  // Zero joint acceleration, so that the classical acceleration of the feet is Jdot v
+  pinocchio::forwardKinematics(*pin_model_, data, pin_q_, pin_v_, wbc_a_);
+  pinocchio::computeJointJacobians(*pin_model_, data);
+  pinocchio::updateFramePlacements(*pin_model_, data);
+  bool contact[4];
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    Eigen::Matrix<double, 6, 18> jac;
+    jac.setZero();
+    pinocchio::getFrameJacobian(*pin_model_, data, foot_frame_ids_[leg], pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED,
+                                jac);
+    wbc_j_.middleRows<3>(3 * leg) = jac.topRows<3>();
+    pinocchio::Motion acc = pinocchio::getFrameClassicalAcceleration(*pin_model_, data, foot_frame_ids_[leg],
+                                                                      pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED);
+    wbc_jdot_v_.segment<3>(3 * leg) = acc.linear();
+    wbc_foot_force_.segment<3>(3 * leg) = foot_force[leg];
+    contact[leg] = getFootState(LegPrefix(leg)) == STAND;
+  }
+
+  if (!wbc_->update(wbc_m_, wbc_h_, wbc_j_, wbc_jdot_v_, contact, wbc_foot_force_, wbc_tau_))
+  {
+    ROS_WARN_THROTTLE(1., "[Mpc] Whole body control failed, fall back to J^T f");
+    ControllerBase::updateJointTorque(foot_force);
+    return;
+  }
+  // The torques are in the order of the velocity of pinocchio
+  Vec12<double> tau;
+  for (int i = 0; i < 12; ++i)
+    tau(i) = wbc_tau_(v_index_[i] - 6);
+  setFeedforward(tau);
+}
+
 void MpcController::setTraj(const VectorXd& traj)
 {
   traj_ = traj;
@@ -86,7 +364,16 @@ void MpcController::setGaitTable(const VectorXd& table)
   gait_table_ = table;
 }
 
-void MpcController::dynamicCallback(WeightConfig& config, uint32_t /*level*/)  // TODO: real time safe
+void MpcController::setNextStep(const ros::Time& boundary, double step_duration, const VectorXd& table,
+                                const VectorXd& traj)
+{
+  step_boundary_ = boundary;
+  step_duration_ = step_duration;
+  step_table_ = table;
+  step_traj_ = traj;
+}
+
+void MpcController::dynamicCallback(WeightConfig& config, uint32_t /*level*/)
 {
   if (!dynamic_initialized_)
   {
@@ -114,7 +401,7 @@ void MpcController::dynamicCallback(WeightConfig& config, uint32_t /*level*/)  /
   Matrix<double, 13, 1> weight;
   weight << config.ori_roll, config.ori_pitch, config.ori_yaw, config.pos_x, config.pos_y, config.pos_z,
       config.rate_roll, config.rate_pitch, config.rate_yaw, config.vel_x, config.vel_y, config.vel_z, 0.;
-  horizon_ = config.horizon;
+  // Only staged here, the solver swaps it in between two solves
   solver_->setup(config.dt, config.horizon, 200., weight, config.alpha, 1.0);
   ROS_INFO("[Mpc] Dynamic params update");
 }
@@ -12,8 +12,8 @@
 
 namespace cheetah_ros
 {
-void MpcFormulation::setup(int horizon, const Matrix<double, STATE_DIM, 1>& weight, double alpha,
-                           double final_cost_scale)
+template <typename T>
+void MpcFormulationTpl<T>::setup(int horizon, const Matrix<T, STATE_DIM, 1>& weight, T alpha, T final_cost_scale)
 {
   horizon_ = horizon;
   final_cost_scale_ = final_cost_scale;
@@ -46,54 +46,66 @@ void MpcFormulation::setup(int horizon, const Matrix<double, STATE_DIM, 1>& weig
 //   [ 0, -c,  b]
 //   [ c,  0, -a]
 //   [-b,  a,  0]
-Matrix3d convertToSkewSymmetric(const Vector3d& vec)
+template <typename T>
+Mat3<T> convertToSkewSymmetric(const Vec3<T>& vec)
 {
-  Matrix3d skew_sym_mat;
+  Mat3<T> skew_sym_mat;
   skew_sym_mat << 0, -vec(2), vec(1), vec(2), 0, -vec(0), -vec(1), vec(0), 0;
   return skew_sym_mat;
 }
 
-void MpcFormulation::buildStateSpace(double mass, const Matrix3d& inertia, const RobotState& state)
+template <typename T>
+void MpcFormulationTpl<T>::buildStateSpace(T mass, const Mat3<T>& inertia, const RobotStateTpl<T>& state)
 {
-  Matrix3d angular_velocity_to_rpy_rate;
-  Vector3d rpy = quatToRPY(state.quat_);
-  double yaw_cos = std::cos(rpy(2));
-  double yaw_sin = std::sin(rpy(2));
+  Mat3<T> angular_velocity_to_rpy_rate;
+  Vec3<T> rpy = quatToRPY(state.quat_);
+  T yaw_cos = std::cos(rpy(2));
+  T yaw_sin = std::sin(rpy(2));
   angular_velocity_to_rpy_rate << yaw_cos, yaw_sin, 0, -yaw_sin, yaw_cos, 0, 0, 0, 1;
 
-  Matrix<double, 3, 4> r_feet;
+  Matrix<T, 3, 4> r_feet;
   for (int i = 0; i < 4; ++i)
     r_feet.col(i) = state.foot_pos_[i] - state.pos_;
 
-  a_c_.block<3, 3>(0, 6) = angular_velocity_to_rpy_rate;
+  a_c_.template block<3, 3>(0, 6) = angular_velocity_to_rpy_rate;
 
   a_c_(3, 9) = 1.;
   a_c_(4, 10) = 1.;
   a_c_(5, 11) = 1.;
   a_c_(11, 12) = 1.;
 
-  Matrix3d inertia_world = angular_velocity_to_rpy_rate.transpose() * inertia * angular_velocity_to_rpy_rate;
+  Mat3<T> inertia_world = angular_velocity_to_rpy_rate.transpose() * inertia * angular_velocity_to_rpy_rate;
   //  b contains non_zero elements only in row 6 : 12.
   for (int i = 0; i < 4; ++i)
   {
-    b_c_.block<3, 3>(6, i * 3) = inertia_world.inverse() * convertToSkewSymmetric(r_feet.col(i));
-    b_c_.block(9, i * 3, 3, 3) = Matrix<double, 3, 3>::Identity() / mass;
+    b_c_.template block<3, 3>(6, i * 3) = inertia_world.inverse() * convertToSkewSymmetric<T>(r_feet.col(i));
+    b_c_.block(9, i * 3, 3, 3) = Mat3<T>::Identity() / mass;
   }
 }
 
-void MpcFormulation::buildQp(double dt)
+template <typename T>
+void MpcFormulationTpl<T>::discretize(T dt, Matrix<T, STATE_DIM, STATE_DIM>& a_dt,
+                                      Matrix<T, STATE_DIM, ACTION_DIM>& b_dt)
 {
   // Convert model from continuous to discrete time
-  Matrix<double, STATE_DIM + ACTION_DIM, STATE_DIM + ACTION_DIM> ab_c;
+  Matrix<T, STATE_DIM + ACTION_DIM, STATE_DIM + ACTION_DIM> ab_c;
   ab_c.setZero();
   ab_c.block(0, 0, STATE_DIM, STATE_DIM) = a_c_;
   ab_c.block(0, STATE_DIM, STATE_DIM, ACTION_DIM) = b_c_;
   ab_c = dt * ab_c;
-  Matrix<double, STATE_DIM + ACTION_DIM, STATE_DIM + ACTION_DIM> exp = ab_c.exp();
-  Matrix<double, STATE_DIM, STATE_DIM> a_dt = exp.block(0, 0, STATE_DIM, STATE_DIM);
-  Matrix<double, STATE_DIM, ACTION_DIM> b_dt = exp.block(0, STATE_DIM, STATE_DIM, ACTION_DIM);
+  Matrix<T, STATE_DIM + ACTION_DIM, STATE_DIM + ACTION_DIM> exp = ab_c.exp();
+  a_dt = exp.block(0, 0, STATE_DIM, STATE_DIM);
+  b_dt = exp.block(0, STATE_DIM, STATE_DIM, ACTION_DIM);
+}
+
+template <typename T>
+void MpcFormulationTpl<T>::buildQp(T dt)
+{
+  Matrix<T, STATE_DIM, STATE_DIM> a_dt;
+  Matrix<T, STATE_DIM, ACTION_DIM> b_dt;
+  discretize(dt, a_dt, b_dt);
 
-  std::vector<Matrix<double, STATE_DIM, STATE_DIM>> power_mats;
+  std::vector<Matrix<T, STATE_DIM, STATE_DIM>> power_mats;
   power_mats.resize(horizon_ + 1);
   for (auto& power_mat : power_mats)
     power_mat.setZero();
@@ -116,41 +128,55 @@ void MpcFormulation::buildQp(double dt)
   }
 }
 
-const Matrix<double, Dynamic, Dynamic, Eigen::RowMajor>& MpcFormulation::buildHessianMat()
+template <typename T>
+const Matrix<T, Dynamic, Dynamic, Eigen::RowMajor>& MpcFormulationTpl<T>::buildHessianMat()
 {
   h_ = /*2. * */ (b_qp_.transpose() * l_ * b_qp_ + alpha_);
   return h_;
 }
 
-const VectorXd& MpcFormulation::buildGVec(double gravity, const RobotState& state,
-                                          const Matrix<double, Dynamic, 1>& traj)
+template <typename T>
+const DVec<T>& MpcFormulationTpl<T>::buildGVec(T gravity, const RobotStateTpl<T>& state,
+                                               const Matrix<double, Dynamic, 1>& traj, T prediction,
+                                               const Matrix<T, ACTION_DIM, 1>& force)
 {
   // Update x_0 and x_ref
-  Matrix<double, STATE_DIM, 1> x_0;
-  VectorXd x_ref(STATE_DIM * horizon_);
+  Matrix<T, STATE_DIM, 1> x_0;
+  DVec<T> x_ref(STATE_DIM * horizon_);
 
-  Vector3d rpy = quatToRPY(state.quat_);
+  Vec3<T> rpy = quatToRPY(state.quat_);
   x_0 << rpy(0), rpy(1), rpy(2), state.pos_, state.angular_vel_, state.linear_vel_, gravity;
+  if (prediction > 0.)
+  {
+    Matrix<T, STATE_DIM, STATE_DIM> a_dt;
+    Matrix<T, STATE_DIM, ACTION_DIM> b_dt;
+    discretize(prediction, a_dt, b_dt);
+    x_0 = a_dt * x_0 + b_dt * force;
+  }
   for (int i = 0; i < horizon_; i++)
     for (int j = 0; j < STATE_DIM - 1; j++)
-      x_ref(STATE_DIM * i + j, 0) = traj[12 * i + j];
+      x_ref(STATE_DIM * i + j, 0) = static_cast<T>(traj[12 * i + j]);
 
-  g_ = /*2. * */ b_qp_.transpose() * l_ * (a_qp_ * x_0 - x_ref);
+  DVec<T> error = a_qp_ * x_0 - x_ref;
+  g_ = /*2. * */ b_qp_.transpose() * l_ * error;
+  cost_offset_ = T(0.5) * error.dot(l_ * error);
   return g_;
 }
 
-const Matrix<double, Dynamic, Dynamic, Eigen::RowMajor>& MpcFormulation::buildConstrainMat(double mu)
+template <typename T>
+const Matrix<T, Dynamic, Dynamic, Eigen::RowMajor>& MpcFormulationTpl<T>::buildConstrainMat(T mu)
 {
   a_.setZero();
-  double mu_inv = 1.f / mu;
-  Matrix<double, 5, 3> a_block;
+  T mu_inv = 1.f / mu;
+  Matrix<T, 5, 3> a_block;
   a_block << mu_inv, 0, 1., -mu_inv, 0, 1., 0, mu_inv, 1., 0, -mu_inv, 1., 0, 0, 1.;
   for (int i = 0; i < horizon_ * 4; i++)
     a_.block(i * 5, i * 3, 5, 3) = a_block;
   return a_;
 }
 
-const VectorXd& MpcFormulation::buildConstrainUpperBound(double f_max, const VectorXd& gait_table)
+template <typename T>
+const DVec<T>& MpcFormulationTpl<T>::buildConstrainUpperBound(T f_max, const VectorXd& gait_table)
 {
   for (int i = 0; i < horizon_; ++i)
   {
@@ -161,16 +187,20 @@ const VectorXd& MpcFormulation::buildConstrainUpperBound(double f_max, const Vec
       ub_a_(row + 1) = BIG_VALUE;
       ub_a_(row + 2) = BIG_VALUE;
       ub_a_(row + 3) = BIG_VALUE;
-      ub_a_(row + 4) = f_max * gait_table(i * 4 + j);
+      ub_a_(row + 4) = f_max * static_cast<T>(gait_table(i * 4 + j));
     }
   }
   return ub_a_;
 }
 
-const VectorXd& MpcFormulation::buildConstrainLowerBound()
+template <typename T>
+const DVec<T>& MpcFormulationTpl<T>::buildConstrainLowerBound()
 {
   lb_a_.setZero();
   return lb_a_;
 }
 
+template class MpcFormulationTpl<double>;
+template class MpcFormulationTpl<float>;
+
 }  // namespace cheetah_ros
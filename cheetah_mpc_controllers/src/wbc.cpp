@@ -0,0 +1,99 @@
+#include "cheetah_mpc_controllers/wbc.h"
+
+namespace cheetah_ros
+{
+Wbc::Wbc(double mu, double force_weight, double swing_weight, double reg_weight)
+  : mu_(mu)
+  , force_weight_(force_weight)
+  , swing_weight_(swing_weight)
+  , reg_weight_(reg_weight)
+  , qp_(NX, NC)
+  , hot_start_(false)
+{
+  qpOASES::Options options;
+  options.setToMPC();
+  options.printLevel = qpOASES::PL_NONE;
+  qp_.setOptions(options);
+
+  a_qp_.setZero();
+  // Friction cone, the same as MpcFormulation::buildConstrainMat()
+  double mu_inv = 1. / mu_;
+  Eigen::Matrix<double, 5, 3> a_block;
+  a_block << mu_inv, 0, 1., -mu_inv, 0, 1., 0, mu_inv, 1., 0, -mu_inv, 1., 0, 0, 1.;
+  for (int leg = 0; leg < 4; ++leg)
+    a_qp_.block<5, 3>(18 + leg * 5, NV + leg * 3) = a_block;
+  x_.setZero();
+}
+
+bool Wbc::update(const MatM& m, const Vec18<double>& h, const MatJ& j, const Vec12<double>& jdot_v,
+                 const bool contact[4], const Vec12<double>& foot_force, Vec12<double>& tau)
+{
+  m_llt_.compute(m);
+  m_inv_jt_ = m_llt_.solve(j.transpose());
+
+  h_qp_.setZero();
+  g_qp_.setZero();
+  h_qp_.topLeftCorner<NV, NV>().diagonal().setConstant(reg_weight_);
+  h_qp_.bottomRightCorner<12, 12>().diagonal().setConstant(force_weight_);
+
+  // Floating base dynamics: M_b qdd + h_b = J_b^T f
+  a_qp_.block<6, NV>(0, 0) = m.topRows<6>();
+  a_qp_.block<6, 12>(0, NV) = -j.leftCols<6>().transpose();
+  lb_a_.head<6>() = -h.head<6>();
+  ub_a_.head<6>() = -h.head<6>();
+
+  lb_.head<NV>().setConstant(-BIG_VALUE);
+  ub_.head<NV>().setConstant(BIG_VALUE);
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    const int row = 6 + 3 * leg;
+    a_qp_.block<3, NV>(row, 0) = j.middleRows<3>(3 * leg);
+    if (contact[leg])
+    {
+      // Stance foot does not accelerate: J qdd + Jdot v = 0
+      lb_a_.segment<3>(row) = -jdot_v.segment<3>(3 * leg);
+      ub_a_.segment<3>(row) = -jdot_v.segment<3>(3 * leg);
+      lb_a_.segment<5>(18 + leg * 5).setZero();
+      ub_a_.segment<5>(18 + leg * 5).setConstant(BIG_VALUE);
+      lb_.segment<3>(NV + 3 * leg).setConstant(-BIG_VALUE);
+      ub_.segment<3>(NV + 3 * leg).setConstant(BIG_VALUE);
+      // Track the ground reaction force, which is opposite to the force of the foot
+      g_qp_.segment<3>(NV + 3 * leg) = force_weight_ * foot_force.segment<3>(3 * leg);
+    }
+    else
+    {
+      lb_a_.segment<3>(row).setConstant(-BIG_VALUE);
+      ub_a_.segment<3>(row).setConstant(BIG_VALUE);
+      lb_a_.segment<5>(18 + leg * 5).setConstant(-BIG_VALUE);
+      ub_a_.segment<5>(18 + leg * 5).setConstant(BIG_VALUE);
+      lb_.segment<3>(NV + 3 * leg).setZero();
+      ub_.segment<3>(NV + 3 * leg).setZero();
+      // Swing foot acceleration caused by the cartesian force through the leg: a = J M^-1 J^T F
+      Eigen::Matrix<double, 3, NV> j_leg = j.middleRows<3>(3 * leg);
+      Vec3<double> acc_des = j_leg * m_inv_jt_.middleCols<3>(3 * leg) * foot_force.segment<3>(3 * leg);
+      h_qp_.topLeftCorner<NV, NV>() += swing_weight_ * j_leg.transpose() * j_leg;
+      g_qp_.head<NV>() += swing_weight_ * j_leg.transpose() * (jdot_v.segment<3>(3 * leg) - acc_des);
+    }
+  }
+
+  int n_wsr = 100;
+  qpOASES::returnValue rvalue;
+  if (hot_start_)
+    rvalue = qp_.hotstart(h_qp_.data(), g_qp_.data(), a_qp_.data(), lb_.data(), ub_.data(), lb_a_.data(),
+                          ub_a_.data(), n_wsr);
+  else
+    rvalue = qp_.init(h_qp_.data(), g_qp_.data(), a_qp_.data(), lb_.data(), ub_.data(), lb_a_.data(), ub_a_.data(),
+                      n_wsr);
+  if (rvalue != qpOASES::SUCCESSFUL_RETURN || qp_.getPrimalSolution(x_.data()) != qpOASES::SUCCESSFUL_RETURN)
+  {
+    hot_start_ = false;  // Cold start at the next tick
+    return false;
+  }
+  hot_start_ = true;
+
+  // Joint rows of M qdd + h = S^T tau + J^T f
+  tau = m.bottomRows<12>() * x_.head<NV>() + h.tail<12>() - j.rightCols<12>().transpose() * x_.tail<12>();
+  return true;
+}
+
+}  // namespace cheetah_ros
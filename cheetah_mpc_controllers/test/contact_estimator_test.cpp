@@ -0,0 +1,123 @@
+// Check the hysteresis, the offset tracking and the touchdown height of the contact estimator, and time one tick.
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <cheetah_common/contact_estimator.h>
+
+using namespace std;
+using namespace chrono;
+
+using namespace cheetah_ros;
+
+// One tick of the whole estimator must fit in this budget
+const double BUDGET = 5.;
+
+bool check(bool condition, const char* what)
+{
+  if (!condition)
+    std::cout << "FAIL: " << what << std::endl;
+  return condition;
+}
+
+// Force only, the default calibration: offset 0, threshold 10, scale 5, enter above 0.7, leave below 0.3
+bool testHysteresis()
+{
+  ContactEstimator<double> estimator;
+  auto tick = [&estimator](double force) {
+    estimator.begin();
+    estimator.addForce(0, force);
+    estimator.end();
+    return estimator.isContact(0);
+  };
+  bool pass = true;
+  pass &= check(!tick(12.), "enter the contact between the thresholds");          // p = 0.60
+  pass &= check(tick(16.), "enter the contact above the high threshold");         // p = 0.77
+  pass &= check(tick(8.), "keep the contact between the thresholds");             // p = 0.40
+  pass &= check(!tick(4.), "leave the contact below the low threshold");          // p = 0.23
+  pass &= check(!tick(12.), "keep the swing between the thresholds");             // p = 0.60
+  pass &= check(std::abs(estimator.getProbability(0) - 1. / (1. + std::exp(-0.4))) < 1e-9, "probability of the force");
+  return pass;
+}
+
+// The offset follows a drifting sensor while the foot is surely in the air, never while it is loaded
+bool testOffsetTracking()
+{
+  ContactEstimator<double> estimator;
+  estimator.setOffsetTracking(0.1);
+  for (int i = 0; i < 200; ++i)
+  {
+    estimator.begin();
+    estimator.addForce(0, 3.);  // Drifted reading of a foot in the air
+    estimator.addProbability(0, 0.01);
+    estimator.addForce(1, 30.);  // Loaded foot
+    estimator.addProbability(1, 0.99);
+    estimator.addForce(2, 8.);  // Not surely in the air
+    estimator.end();
+  }
+  bool pass = true;
+  pass &= check(!estimator.isContact(0) && std::abs(estimator.getForceOffset(0) - 3.) < 1e-3,
+                "track the offset during the swing");
+  pass &= check(estimator.isContact(1) && estimator.getForceOffset(1) == 0., "freeze the offset during the stance");
+  pass &= check(estimator.getForceOffset(2) == 0., "freeze the offset when the swing is not sure");
+  return pass;
+}
+
+// The height at the entry of the contact is the reference of the kinematic evidence
+bool testTouchdownHeight()
+{
+  ContactEstimator<double> estimator;
+  auto tick = [&estimator](double force, double height) {
+    estimator.begin();
+    estimator.addForce(0, force);
+    estimator.addKinematics(0, height, 0.);
+    estimator.end();
+    return estimator.getProbability(0);
+  };
+  tick(0., 0.1);    // Swing
+  tick(40., 0.05);  // Touchdown on a step
+  bool pass = check(estimator.isContact(0), "touchdown");
+  // At the threshold of the force, only the kinematics is left: +2 at the touchdown height, -2 one height_scale above
+  pass &= check(std::abs(tick(10., 0.05) - 1. / (1. + std::exp(-2.))) < 1e-9, "evidence at the touchdown height");
+  pass &= check(std::abs(tick(10., 0.08) - 1. / (1. + std::exp(2.))) < 1e-9, "evidence above the touchdown height");
+  return pass;
+}
+
+bool testTime()
+{
+  ContactEstimator<double> estimator;
+  estimator.setOffsetTracking(0.001);
+  const int ticks = 100000;
+  double sum = 0.;
+  auto start = steady_clock::now();
+  for (int i = 0; i < ticks; ++i)
+  {
+    double phase = (i % 500) / 500.;
+    estimator.begin();
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      bool stance = (phase < 0.5) == (leg == 0 || leg == 3);
+      estimator.addForce(leg, stance ? 60. + leg : 2. + 0.01 * leg);
+      estimator.addProbability(leg, stance ? 0.8 : 0.2);
+      estimator.addKinematics(leg, stance ? 0. : 0.05 * phase, stance ? 0. : 0.3);
+    }
+    estimator.end();
+    sum += estimator.getProbability(i % 4);
+  }
+  double spend = double(duration_cast<nanoseconds>(steady_clock::now() - start).count()) * 1e-3 / ticks;
+  std::cout << "Contact estimator tick " << spend << " us, budget " << BUDGET << " us (checksum " << sum << ")"
+            << std::endl;
+  return check(spend < BUDGET, "time of a tick");
+}
+
+int main()
+{
+  bool hysteresis = testHysteresis();
+  bool offset = testOffsetTracking();
+  bool touchdown = testTouchdownHeight();
+  bool time = testTime();
+  bool pass = hysteresis && offset && touchdown && time;
+  std::cout << "Contact estimator: " << (pass ? "PASS" : "FAIL") << std::endl;
+  return pass ? 0 : 1;
+}
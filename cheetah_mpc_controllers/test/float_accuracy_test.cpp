@@ -0,0 +1,134 @@
+// Compare the single precision mpc formulation and state estimator against the double ones, on the same inputs.
+
+#include <iostream>
+
+#include <cheetah_mpc_controllers/mpc_solver.h>
+#include <cheetah_basic_controllers/linear_kf.h>
+
+using namespace cheetah_ros;
+using namespace Eigen;
+
+template <typename T>
+void buildFormulation(MpcFormulationTpl<T>& formulation, int horizon, const RobotState& state, const VectorXd& traj,
+                      const VectorXd& gait_table)
+{
+  Matrix<double, 13, 1> weight;
+  weight << 0.25, 0.25, 10, 2, 2, 20, 0, 0, 0.3, 0.2, 0.2, 0.2, 0.;
+  Matrix3d inertia;
+  inertia << 0.050874, 0., 0., 0., 0.64036, 0., 0., 0., 0.6565;
+  RobotStateTpl<T> state_t = state.cast<T>();
+
+  formulation.setup(horizon, weight.cast<T>(), 1e-6, 1.);
+  formulation.buildStateSpace(11.041, inertia.cast<T>(), state_t);
+  formulation.buildQp(0.03);
+  formulation.buildHessianMat();
+  formulation.buildGVec(-9.81, state_t, traj, 0.002);
+  formulation.buildConstrainMat(0.6);
+  formulation.buildConstrainUpperBound(150., gait_table);
+  formulation.buildConstrainLowerBound();
+}
+
+template <typename Derived, typename OtherDerived>
+double relativeError(const MatrixBase<Derived>& single, const MatrixBase<OtherDerived>& reference)
+{
+  return (single.template cast<double>() - reference).norm() / reference.norm();
+}
+
+bool testMpc()
+{
+  int horizon = 10;
+  RobotState state;
+  state.pos_ << 0.01, -0.02, 0.28;
+  state.quat_ = AngleAxisd(0.3, Vector3d::UnitZ()) * AngleAxisd(0.02, Vector3d::UnitY());
+  state.linear_vel_ << 0.4, 0.05, 0.;
+  state.angular_vel_ << 0.01, -0.02, 0.1;
+  state.foot_pos_[0] << 0.2, 0.15, 0.;
+  state.foot_pos_[1] << 0.2, -0.15, 0.;
+  state.foot_pos_[2] << -0.2, 0.15, 0.;
+  state.foot_pos_[3] << -0.2, -0.15, 0.;
+
+  VectorXd traj(12 * horizon), gait_table(4 * horizon);
+  traj.setZero();
+  for (int i = 0; i < horizon; ++i)
+  {
+    traj[12 * i + 2] = 0.3;
+    traj[12 * i + 3] = 0.5 * 0.03 * i;
+    traj[12 * i + 5] = 0.28;
+    traj[12 * i + 9] = 0.5;
+    // Trot
+    bool first_pair = (i / 5) % 2 == 0;
+    gait_table.segment<4>(4 * i) << first_pair, !first_pair, !first_pair, first_pair;
+  }
+
+  MpcFormulationTpl<double> reference;
+  MpcFormulationTpl<float> single;
+  buildFormulation(reference, horizon, state, traj, gait_table);
+  buildFormulation(single, horizon, state, traj, gait_table);
+  double h_error = relativeError(single.h_, reference.h_);
+  double g_error = relativeError(single.g_, reference.g_);
+  std::cout << "Relative error of the hessian " << h_error << ", of the g vector " << g_error << std::endl;
+
+  std::vector<qpOASES::real_t> reference_sol(12 * horizon), single_sol(12 * horizon);
+  double reference_cost, single_cost;
+  bool feasible = QpOasesSolver::solveQp(reference, reference.a_.data(), reference_sol.data(), reference_cost) &&
+                  QpOasesSolver::solveQp(single, single.a_.data(), single_sol.data(), single_cost);
+  double force_error = 0.;
+  for (int i = 0; i < 12; ++i)  // The forces of the first step, which are applied
+    force_error = std::max(force_error, std::abs(single_sol[i] - reference_sol[i]));
+  std::cout << "Largest error of the applied forces " << force_error << " N" << std::endl;
+
+  return feasible && h_error < 1e-5 && g_error < 1e-4 && force_error < 0.5;
+}
+
+bool testKf()
+{
+  LinearKFPosVel<double> reference;
+  LinearKFPosVel<float> single;
+  RobotState state;
+  state.quat_.setIdentity();
+  state.accel_ << 0., 0., 9.81;
+  state.pos_.setZero();
+  state.linear_vel_.setZero();
+  RobotStateTpl<float> state_single = state.cast<float>();
+
+  // Walk at 0.5 m/s for 2 s in a trot of 0.5 s, the feet in stance stay on the ground
+  double max_pos_error = 0., max_vel_error = 0.;
+  Vector3d base(0., 0., 0.28), feet[4];
+  for (int leg = 0; leg < 4; ++leg)
+    feet[leg] << (leg < 2 ? 0.2 : -0.2), (leg % 2 == 0 ? 0.15 : -0.15), 0.;
+  for (int tick = 0; tick < 2000; ++tick)
+  {
+    double time = tick * 0.001;
+    base.x() = 0.5 * time;
+    bool first_pair = std::fmod(time, 0.5) < 0.25;
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      bool stance = (leg == 0 || leg == 3) == first_pair;
+      if (!stance)
+        feet[leg].x() = base.x() + (leg < 2 ? 0.2 : -0.2) + 0.5 * 0.125;
+      // The kinematics is relative to the estimated base, the same as ControllerBase
+      state.contact_state_[leg] = stance;
+      state.foot_pos_[leg] = state.pos_ + feet[leg] - base;
+      state.foot_vel_[leg] = stance ? Vector3d(0., 0., 0.) : Vector3d(0.5, 0., 0.);
+      state_single.contact_state_[leg] = stance;
+      state_single.foot_pos_[leg] = state_single.pos_ + (feet[leg] - base).cast<float>();
+      state_single.foot_vel_[leg] = state.foot_vel_[leg].cast<float>();
+    }
+    reference.update(state);
+    single.update(state_single);
+    max_pos_error = std::max(max_pos_error, (state_single.pos_.cast<double>() - state.pos_).norm());
+    max_vel_error = std::max(max_vel_error, (state_single.linear_vel_.cast<double>() - state.linear_vel_).norm());
+  }
+  std::cout << "Largest error of the estimated position " << max_pos_error << " m, velocity " << max_vel_error
+            << " m/s" << std::endl;
+  return max_pos_error < 1e-3 && max_vel_error < 1e-2;
+}
+
+int main()
+{
+  bool mpc = testMpc();
+  bool kf = testKf();
+  std::cout << "mpc formulation: " << (mpc ? "PASS" : "FAIL") << ", state estimator: " << (kf ? "PASS" : "FAIL")
+            << std::endl;
+  return mpc && kf ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Check that MpcBatchEvaluator gives the same results as sequential solves, whatever the number of threads.
+
+#include <iostream>
+
+#include <cheetah_mpc_controllers/mpc_batch.h>
+#include <cheetah_common/math_utilities.h>
+
+using namespace cheetah_ros;
+using namespace Eigen;
+
+MpcCases buildCases()
+{
+  MpcCases cases;
+  for (int i = 0; i < 12; ++i)
+  {
+    MpcCase mpc_case;
+    mpc_case.horizon_ = 5 + i % 3 * 5;
+    mpc_case.dt_ = 0.03;
+    mpc_case.alpha_ = 1e-6;
+    mpc_case.weight_ << 0.25, 0.25, 10, 2, 2, 20, 0, 0, 0.3, 0.2, 0.2, 0.2, 0.;
+    mpc_case.state_.pos_ << 0., 0., 0.25 + 0.005 * i;
+    mpc_case.state_.quat_ = RpyToQuat(Vector3d(0.01 * i, -0.01 * i, 0.1 * i));
+    mpc_case.state_.angular_vel_ << 0., 0., 0.05 * i;
+    mpc_case.state_.linear_vel_ << 0.05 * i, 0., 0.;
+    mpc_case.state_.foot_pos_[0] << 0.2, 0.15, -0.25;
+    mpc_case.state_.foot_pos_[1] << 0.2, -0.15, -0.25;
+    mpc_case.state_.foot_pos_[2] << -0.2, 0.15, -0.25;
+    mpc_case.state_.foot_pos_[3] << -0.2, -0.15, -0.25;
+    // Stand for the even cases, trot for the odd ones
+    mpc_case.gait_table_.resize(4 * mpc_case.horizon_);
+    for (int step = 0; step < mpc_case.horizon_; ++step)
+    {
+      bool pair = (step / 2) % 2;
+      if (i % 2 == 0)
+        mpc_case.gait_table_.segment<4>(4 * step).setOnes();
+      else
+        mpc_case.gait_table_.segment<4>(4 * step) << pair, !pair, !pair, pair;
+    }
+    mpc_case.traj_.setZero(12 * mpc_case.horizon_);
+    for (int step = 0; step < mpc_case.horizon_; ++step)
+    {
+      mpc_case.traj_[12 * step + 3] = 0.05 * i * mpc_case.dt_ * step;
+      mpc_case.traj_[12 * step + 5] = 0.3;
+      mpc_case.traj_[12 * step + 9] = 0.05 * i;
+    }
+    cases.push_back(mpc_case);
+  }
+  return cases;
+}
+
+// Bitwise equality, each problem is solved by one thread from the same inputs
+bool sameResult(const MpcResult& a, const MpcResult& b)
+{
+  if (a.feasible_ != b.feasible_ || a.cost_ != b.cost_)
+    return false;
+  for (int leg = 0; leg < 4; ++leg)
+    if (a.force_[leg] != b.force_[leg])
+      return false;
+  return true;
+}
+
+int main()
+{
+  double mass = 11.041, gravity = -9.81, mu = 0.6, f_max = 200.;
+  Matrix3d inertia;
+  inertia << 0.050874, 0., 0., 0., 0.64036, 0., 0., 0., 0.6565;
+  MpcCases cases = buildCases();
+
+  std::vector<MpcResult> sequential;
+  for (const auto& mpc_case : cases)
+    sequential.push_back(MpcBatchEvaluator::evaluate(mpc_case, mass, gravity, mu, inertia, f_max));
+  bool pass = true;
+  for (size_t i = 0; i < sequential.size(); ++i)
+    if (!sequential[i].feasible_)
+    {
+      std::cout << "FAIL: case " << i << " is not feasible" << std::endl;
+      pass = false;
+    }
+
+  for (int threads : { 1, 2, 4, 7 })
+  {
+    MpcBatchEvaluator evaluator(mass, gravity, mu, inertia, f_max, threads);
+    std::vector<MpcResult> results;
+    evaluator.evaluate(cases, results);
+    int mismatches = 0;
+    for (size_t i = 0; i < cases.size(); ++i)
+      mismatches += !sameResult(results[i], sequential[i]);
+    std::cout << threads << " threads: " << mismatches << " of " << cases.size() << " cases differ" << std::endl;
+    pass &= results.size() == cases.size() && mismatches == 0;
+  }
+  std::cout << "Mpc batch: " << (pass ? "PASS" : "FAIL") << std::endl;
+  return pass ? 0 : 1;
+}
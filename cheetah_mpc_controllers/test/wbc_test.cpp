@@ -0,0 +1,114 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+#include <pinocchio/fwd.hpp>
+#include <pinocchio/parsers/urdf.hpp>
+#include <pinocchio/algorithm/joint-configuration.hpp>
+#include <pinocchio/algorithm/center-of-mass.hpp>
+#include <pinocchio/algorithm/crba.hpp>
+#include <pinocchio/algorithm/rnea.hpp>
+#include <pinocchio/algorithm/kinematics.hpp>
+#include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/jacobian.hpp>
+
+#include <cheetah_mpc_controllers/wbc.h>
+
+using namespace std;
+using namespace chrono;
+
+using namespace cheetah_ros;
+using namespace Eigen;
+
+// The whole tick of MpcController::updateJointTorque() with the wbc enabled must fit in this budget
+const double BUDGET = 200.;
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    // E.g. rosrun xacro xacro `rospack find unitree_description`/urdf/robot.xacro robot_type:=a1 > a1.urdf
+    std::cerr << "Usage: wbc_test <urdf of the robot>" << endl;
+    return 2;
+  }
+  std::ifstream file(argv[1]);
+  std::stringstream urdf;
+  urdf << file.rdbuf();
+  pinocchio::Model model;
+  pinocchio::urdf::buildModelFromXML(urdf.str(), pinocchio::JointModelFreeFlyer(), model);
+  pinocchio::Data data(model);
+  if (model.nv != Wbc::NV)
+  {
+    std::cerr << "Expect a quadruped with 12 joints, but the urdf has " << model.nv - 6 << endl;
+    return 2;
+  }
+
+  // Standing in the nominal configuration of the mpc
+  VectorXd q = pinocchio::neutral(model), v = VectorXd::Zero(model.nv), a = VectorXd::Zero(model.nv);
+  q(2) = 0.3;
+  const double joint_pos[3] = { 0., 0.67, -1.3 };
+  const std::string joint_names[3] = { "_hip_joint", "_thigh_joint", "_calf_joint" };
+  pinocchio::FrameIndex foot_frame_ids[4];
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    for (int joint = 0; joint < 3; ++joint)
+      q(model.joints[model.getJointId(LEG_PREFIX[leg] + joint_names[joint])].idx_q()) = joint_pos[joint];
+    foot_frame_ids[leg] = model.getFrameId(LEG_PREFIX[leg] + "_foot");
+  }
+  double weight = pinocchio::computeTotalMass(model) * -model.gravity.linear().z();
+
+  Wbc wbc(0.6, 1., 1., 1e-4);
+  Wbc::MatM m;
+  Vec18<double> h;
+  Wbc::MatJ j;
+  Vec12<double> jdot_v, foot_force, tau;
+
+  srand(0);
+  const int ticks = 1000;
+  double total = 0., max = 0.;
+  int failed = 0;
+  for (int i = 0; i < ticks; ++i)
+  {
+    // Trot, switch the diagonal pairs every 150 ticks
+    bool pair = (i / 150) % 2;
+    bool contact[4] = { pair, !pair, !pair, pair };
+    foot_force.setZero();
+    for (int leg = 0; leg < 4; ++leg)
+      foot_force(3 * leg + 2) = contact[leg] ? -weight / 2 : 0.;
+    v = VectorXd::Random(model.nv) * 0.1;
+
+    auto start = steady_clock::now();
+    // The same as MpcController::updateJointTorque()
+    pinocchio::crba(model, data, q);
+    data.M.triangularView<StrictlyLower>() = data.M.transpose().triangularView<StrictlyLower>();
+    m = data.M;
+    h = pinocchio::nonLinearEffects(model, data, q, v);
+    pinocchio::forwardKinematics(model, data, q, v, a);
+    pinocchio::computeJointJacobians(model, data);
+    pinocchio::updateFramePlacements(model, data);
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      Matrix<double, 6, 18> jac;
+      jac.setZero();
+      pinocchio::getFrameJacobian(model, data, foot_frame_ids[leg], pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED,
+                                  jac);
+      j.middleRows<3>(3 * leg) = jac.topRows<3>();
+      jdot_v.segment<3>(3 * leg) = pinocchio::getFrameClassicalAcceleration(
+                                       model, data, foot_frame_ids[leg], pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED)
+                                       .linear();
+    }
+    if (!wbc.update(m, h, j, jdot_v, contact, foot_force, tau))
+      failed++;
+    double spend = double(duration_cast<nanoseconds>(steady_clock::now() - start).count()) * 1e-3;
+    total += spend;
+    // The first tick is a cold start of the QP
+    if (i > 0)
+      max = std::max(max, spend);
+  }
+  bool pass = max < BUDGET && failed == 0;
+  std::cout << "Wbc tick mean " << total / ticks << " max " << max << " us, budget " << BUDGET << " us, failed "
+            << failed << "/" << ticks << ": " << (pass ? "PASS" : "FAIL") << endl;
+
+  return pass ? 0 : 1;
+}
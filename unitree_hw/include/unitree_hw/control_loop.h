@@ -40,7 +40,9 @@
 #include "hardware_interface.h"
 
 // Timer
+#include <atomic>
 #include <chrono>
+#include <thread>
 #include <utility>
 
 // ROS
@@ -63,6 +65,7 @@ public:
    * @param hardware_interface A pointer which point to hardware_interface.
    */
   UnitreeHWLoop(ros::NodeHandle& nh, std::shared_ptr<UnitreeHW> hardware_interface);
+  ~UnitreeHWLoop();
   /** \brief Timed method that reads current hardware's state, runs the controller code once and sends the new commands
    * to the hardware.
    *
@@ -76,6 +79,10 @@ public:
   void update(const ros::TimerEvent&);
 
 private:
+  void update();
+  // Run update() every time a new state arrives instead of on a timer
+  void phaseLockedLoop();
+
   // Startup and shutdown of the internal node inside a roscpp program
   ros::NodeHandle nh_;
 
@@ -84,6 +91,9 @@ private:
   double cycle_time_error_threshold_{};
 
   // Timing
+  bool phase_lock_{};
+  std::thread loop_thread_;
+  std::atomic<bool> loop_running_{ false };
   ros::Timer loop_timer_;
   ros::Duration elapsed_time_;
   double loop_hz_{};
@@ -20,18 +20,24 @@
 #include <cheetah_common/hardware_interface/hybrid_joint_interface.h>
 #include <cheetah_common/hardware_interface/contact_sensor_interface.h>
 #include <cheetah_common/cpp_types.h>
+#include <cheetah_common/contact_estimator.h>
+#include <cheetah_common/robot_description.h>
 #include <hardware_interface/imu_sensor_interface.h>
 #include <realtime_tools/realtime_publisher.h>
 #include <cheetah_msgs/MotorState.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include "unitree_legged_sdk/udp.h"
+#include "unitree_hw/udp_io.h"
 #include "unitree_legged_sdk/safety.h"
 
 namespace cheetah_ros
 {
-struct UnitreeMotorData
+// Structure of arrays of the 12 joints, in the order of RobotDescription, not the order of the motors
+struct UnitreeJointData
 {
-  double pos_, vel_, tau_;                   // state
-  double pos_des_, vel_des_, kp_, kd_, ff_;  // command
+  double pos_[12], vel_[12], tau_[12];                          // state
+  double pos_des_[12], vel_des_[12], kp_[12], kd_[12], ff_[12];  // command
+  uint64_t cmd_generation_[12];  // The cycle in which the command was last updated
 };
 
 struct UnitreeImuData
@@ -78,6 +84,15 @@ public:
    */
   void write(const ros::Time& time, const ros::Duration& period) override;
 
+  /** \brief Wait until a state newer than the one of the last @ref read() arrives.
+   *
+   * Used to run the control loop phase locked to the stream of the robot.
+   *
+   * @param timeout Longest time to wait in seconds
+   * @return False at timeout.
+   */
+  bool waitForState(double timeout) const;
+
 private:
   /** \brief Load urdf of robot from param server.
    *
@@ -90,32 +105,54 @@ private:
 
   /** \brief Set up Joints.
    *
-   * Set up transmission
+   * Map the joints of the robot description to the motors of the SDK, by the param motor_index or by the names of the
+   * unitree legs.
    *
+   * @param nh Node-handle for robot hardware.
    * @return True if successful.
    */
-  bool setupJoints();
+  bool setupJoints(ros::NodeHandle& nh);
 
   bool setupImu();
 
   bool setupContactSensor(ros::NodeHandle& nh);
 
+  /** \brief Safe default command policy.
+   *
+   * Applied in @ref read() and @ref write() by direct writes into joints_: the feedforward and the desired velocity
+   * are cleared every cycle, and the gains are also cleared for the joints whose command is not updated by any
+   * controller in this cycle.
+   */
+  void applySafeDefault(bool cycle_end);
+
   void publishMotorState(const ros::Time& time);
 
+  // Statistics of the UDP link over the last second, on /diagnostics
+  void publishLinkDiagnostics(const ros::Time& time);
+
   std::shared_ptr<UNITREE_LEGGED_SDK::UDP> udp_;
+  std::shared_ptr<UnitreeUdpIo> udp_io_;
   std::shared_ptr<UNITREE_LEGGED_SDK::Safety> safety_;
-  UNITREE_LEGGED_SDK::LowState low_state_{};
+  StampedLowState low_state_{};
   UNITREE_LEGGED_SDK::LowCmd low_cmd_{};
 
-  UnitreeMotorData joint_data_[20]{};
+  UnitreeJointData joints_{};
+  RobotDescription robot_description_;
+  int motor_index_[12]{};  // Index in motorCmd and motorState of each joint of joints_
+  int foot_index_[4]{};    // Index in footForce of each leg
+  uint64_t generation_{};           // Increased every read()
   UnitreeImuData imu_data_{};
   bool contact_state_[4]{};
-  int contact_threshold_{};
+  double contact_probability_[4]{};
+  double contact_force_[4]{};     // footForce minus the offset of the unloaded foot, in newton
+  double newton_per_count_[4]{};  // Scale of footForce of each foot
+  ContactEstimator<double> contact_estimator_;  // From footForce only, the controllers may add the kinematics
 
   // Interface
   hardware_interface::JointStateInterface joint_state_interface_;
   hardware_interface::ImuSensorInterface imu_sensor_interface_;
   HybridJointInterface hybrid_joint_interface_;
+  HybridJointBlockInterface hybrid_joint_block_interface_;
   ContactSensorInterface contact_sensor_interface_;
 
   // URDF model of the robot
@@ -124,6 +161,17 @@ private:
 
   ros::Time last_publish_time_;
   std::shared_ptr<realtime_tools::RealtimePublisher<cheetah_msgs::MotorState>> actuator_state_pub_;
+
+  // Link statistics, the joints only get damping in write() when the state is stale
+  double stale_timeout_{}, damping_kd_{};
+  bool stale_{ true };
+  uint64_t window_received_{};
+  double window_max_inter_arrival_{};
+  UNITREE_LEGGED_SDK::UDPState window_start_{};
+  uint64_t window_start_lost_{};
+  uint64_t window_start_bad_ticks_{};
+  ros::Time last_diag_;
+  std::shared_ptr<realtime_tools::RealtimePublisher<diagnostic_msgs::DiagnosticArray>> diag_pub_;
 };
 
 }  // namespace cheetah_ros
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+
+namespace cheetah_ros
+{
+/*!
+ * Lock free triple buffer between one writer thread and one reader thread. The writer never blocks and always has a
+ * buffer to fill, the reader always gets the newest complete data, intermediate data may be dropped.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+  // Writer: fill back() then publish()
+  T& back()
+  {
+    return buffers_[back_];
+  }
+  void publish()
+  {
+    back_ = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Reader: update() to take the newest published data, return false if nothing new since the last update()
+  bool update()
+  {
+    if (!(middle_.load(std::memory_order_relaxed) & DIRTY))
+      return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+  const T& front() const
+  {
+    return buffers_[front_];
+  }
+
+private:
+  static constexpr int INDEX = 3;
+  static constexpr int DIRTY = 4;
+
+  T buffers_[3]{};
+  int front_{ 0 }, back_{ 1 };
+  std::atomic<int> middle_{ 2 };
+};
+
+}  // namespace cheetah_ros
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "triple_buffer.h"
+#include "unitree_legged_sdk/udp.h"
+
+namespace cheetah_ros
+{
+struct StampedLowState
+{
+  UNITREE_LEGGED_SDK::LowState state_;
+  std::chrono::steady_clock::time_point stamp_;  // Arrival of the packet
+  uint64_t seq_;                                 // Number of packets received before this one, starting from one
+  double inter_arrival_;                         // Time since the previous packet, in seconds
+  double jitter_;  // Smoothed deviation of the transit time (RFC 3550) using the tick of the robot, in seconds
+  uint64_t lost_;  // Total packets lost, estimated from the gaps of the tick of the robot
+  uint64_t bad_ticks_;  // Total packets whose tick did not advance or jumped, left out of jitter_ and lost_
+  UNITREE_LEGGED_SDK::UDPState udp_state_;  // Counters of the SDK at the arrival
+};
+
+/*!
+ * Run the low level UDP link of the SDK in a dedicated thread. The thread polls the socket, stamps every received
+ * LowState and replies with the newest LowCmd right away, so the commands are phase locked to the stream of the robot.
+ * It also sends on its own when no state is received for send_period, to keep the link alive. The states and commands
+ * are exchanged with the control thread through lock free triple buffers.
+ */
+class UnitreeUdpIo
+{
+public:
+  /*!
+   * @param udp : the link, owned by the I/O thread after start()
+   * @param poll_period : sleep between two polls of the socket, zero to busy poll
+   * @param send_period : the longest time between two sent commands
+   * @param state_period : the period of the stream of the robot, to count the lost packets
+   */
+  UnitreeUdpIo(std::shared_ptr<UNITREE_LEGGED_SDK::UDP> udp, double poll_period, double send_period,
+               double state_period);
+  ~UnitreeUdpIo();
+  void start(const UNITREE_LEGGED_SDK::LowCmd& initial_cmd);
+  void stop();
+
+  // Control thread: return false and keep state unchanged if no packet arrived since the last call
+  bool getState(StampedLowState& state);
+  void setCommand(const UNITREE_LEGGED_SDK::LowCmd& cmd);
+  // Control thread: wait until a state newer than seq arrives, return false at timeout
+  bool waitForState(uint64_t seq, double timeout) const;
+
+private:
+  void loop();
+  void send();
+
+  std::shared_ptr<UNITREE_LEGGED_SDK::UDP> udp_;
+  std::chrono::steady_clock::duration poll_period_, send_period_;
+  double state_period_;
+  std::chrono::steady_clock::time_point last_send_;
+  std::chrono::steady_clock::time_point last_arrival_;
+  uint32_t last_tick_{};
+  double jitter_{};
+  uint64_t lost_{};
+  uint64_t bad_ticks_{};
+
+  TripleBuffer<StampedLowState> state_buffer_;
+  TripleBuffer<UNITREE_LEGGED_SDK::LowCmd> cmd_buffer_;
+  std::atomic<uint64_t> seq_{ 0 };
+
+  std::atomic<bool> running_{ false };
+  std::thread thread_;
+};
+
+}  // namespace cheetah_ros
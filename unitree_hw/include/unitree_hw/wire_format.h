@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "unitree_legged_sdk/comm.h"
+
+namespace UNITREE_LEGGED_SDK
+{
+// Exported by the SDK library but not declared in its headers, len is the number of 32 bits words
+uint32_t crc32(uint32_t* ptr, uint32_t len);
+}  // namespace UNITREE_LEGGED_SDK
+
+namespace cheetah_ros
+{
+/*!
+ * Low level packets as the prebuilt SDK library puts them on the wire. The library packs them tighter than the
+ * structures of comm.h: tau, Kp and Kd of MotorCmd and ddq, tauEst and ddq_raw of MotorState are sent as scaled int16,
+ * and footForceEst is never sent. UDP::SetSend and UDP::GetRecv do the conversion on the side of unitree_hw, these
+ * functions are the other side, for talking to unitree_hw without a robot. The CRC is the last 4 bytes, computed over
+ * the preceding whole 32 bits words. All fields are little endian.
+ */
+namespace unitree_wire
+{
+constexpr size_t LOW_CMD_LENGTH = 610;
+constexpr size_t LOW_STATE_LENGTH = 771;
+
+// Offsets in the packets, the header and the IMU are the same as the structures
+constexpr size_t MOTOR_CMD_OFFSET = 10, MOTOR_CMD_STRIDE = 27;
+constexpr size_t MOTOR_STATE_OFFSET = 63, MOTOR_STATE_STRIDE = 32;
+constexpr size_t FOOT_FORCE_OFFSET = 703, FOOT_FORCE_EST_OFFSET = 711, TICK_OFFSET = 719;
+
+// Scales of the int16 fields, the library truncates toward zero
+constexpr float TAU_SCALE = 256.f, KP_SCALE = 32.f, KD_SCALE = 16.f, DDQ_SCALE = 1.f;
+
+template <typename T>
+inline void put(char* data, size_t offset, const T& value)
+{
+  std::memcpy(data + offset, &value, sizeof(T));
+}
+
+template <typename T>
+inline T get(const char* data, size_t offset)
+{
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+// Saturate rather than wrap around as the library does, a torque out of range should not flip its sign
+inline int16_t toFixed(float value, float scale)
+{
+  return static_cast<int16_t>(std::max(-32768.f, std::min(32767.f, std::trunc(value * scale))));
+}
+
+// The buffer should be 4 bytes aligned and hold length bytes
+inline uint32_t computeCrc(char* data, size_t length)
+{
+  return UNITREE_LEGGED_SDK::crc32(reinterpret_cast<uint32_t*>(data), static_cast<uint32_t>((length >> 2) - 1));
+}
+
+inline bool checkCrc(char* data, size_t length)
+{
+  return length >= 8 && get<uint32_t>(data, length - 4) == computeCrc(data, length);
+}
+
+inline void setCrc(char* data, size_t length)
+{
+  put(data, length - 4, computeCrc(data, length));
+}
+
+// data holds LOW_CMD_LENGTH bytes, the CRC is not checked
+inline void parseLowCmd(const char* data, UNITREE_LEGGED_SDK::LowCmd& cmd)
+{
+  std::memset(&cmd, 0, sizeof(cmd));
+  std::memcpy(&cmd, data, MOTOR_CMD_OFFSET);
+  for (int i = 0; i < 20; ++i)
+  {
+    UNITREE_LEGGED_SDK::MotorCmd& motor = cmd.motorCmd[i];
+    size_t offset = MOTOR_CMD_OFFSET + MOTOR_CMD_STRIDE * i;
+    motor.mode = get<uint8_t>(data, offset);
+    motor.q = get<float>(data, offset + 1);
+    motor.dq = get<float>(data, offset + 5);
+    motor.tau = get<int16_t>(data, offset + 9) / TAU_SCALE;
+    motor.Kp = get<int16_t>(data, offset + 11) / KP_SCALE;
+    motor.Kd = get<int16_t>(data, offset + 13) / KD_SCALE;
+    std::memcpy(motor.reserve, data + offset + 15, sizeof(motor.reserve));
+  }
+  size_t offset = MOTOR_CMD_OFFSET + MOTOR_CMD_STRIDE * 20;
+  std::memcpy(cmd.led, data + offset, sizeof(cmd.led));
+  offset += sizeof(cmd.led);
+  std::memcpy(cmd.wirelessRemote, data + offset, sizeof(cmd.wirelessRemote));
+  offset += sizeof(cmd.wirelessRemote);
+  cmd.reserve = get<uint32_t>(data, offset);
+}
+
+// data holds LOW_STATE_LENGTH bytes, the CRC is left to setCrc
+inline void serializeLowState(const UNITREE_LEGGED_SDK::LowState& state, char* data)
+{
+  std::memset(data, 0, LOW_STATE_LENGTH);
+  std::memcpy(data, &state, MOTOR_STATE_OFFSET);
+  for (int i = 0; i < 20; ++i)
+  {
+    const UNITREE_LEGGED_SDK::MotorState& motor = state.motorState[i];
+    size_t offset = MOTOR_STATE_OFFSET + MOTOR_STATE_STRIDE * i;
+    put(data, offset, motor.mode);
+    put(data, offset + 1, motor.q);
+    put(data, offset + 5, motor.dq);
+    put(data, offset + 9, toFixed(motor.ddq, DDQ_SCALE));
+    put(data, offset + 11, toFixed(motor.tauEst, TAU_SCALE));
+    put(data, offset + 13, motor.q_raw);
+    put(data, offset + 17, motor.dq_raw);
+    put(data, offset + 21, toFixed(motor.ddq_raw, DDQ_SCALE));
+    put(data, offset + 23, motor.temperature);
+    std::memcpy(data + offset + 24, motor.reserve, sizeof(motor.reserve));
+  }
+  std::memcpy(data + FOOT_FORCE_OFFSET, state.footForce, sizeof(state.footForce));
+  std::memcpy(data + FOOT_FORCE_EST_OFFSET, state.footForceEst, sizeof(state.footForceEst));
+  size_t offset = TICK_OFFSET;
+  put(data, offset, state.tick);
+  offset += sizeof(state.tick);
+  std::memcpy(data + offset, state.wirelessRemote, sizeof(state.wirelessRemote));
+  offset += sizeof(state.wirelessRemote);
+  put(data, offset, state.reserve);
+}
+
+}  // namespace unitree_wire
+}  // namespace cheetah_ros
@@ -25,15 +25,45 @@ UnitreeHWLoop::UnitreeHWLoop(ros::NodeHandle& nh, std::shared_ptr<UnitreeHW> har
     throw std::runtime_error(error_message);
   }
 
+  nh_p.param("phase_lock", phase_lock_, false);
+
   // Get current time for use with first update
   last_time_ = steady_clock::now();
 
-  // Start timer that will periodically call RmRobotHWLoop::update
   desired_update_freq_ = ros::Duration(1 / loop_hz_);
-  loop_timer_ = nh_.createTimer(desired_update_freq_, &UnitreeHWLoop::update, this);
+  if (phase_lock_)
+  {
+    loop_running_ = true;
+    loop_thread_ = std::thread(&UnitreeHWLoop::phaseLockedLoop, this);
+  }
+  else  // Start timer that will periodically call RmRobotHWLoop::update
+    loop_timer_ = nh_.createTimer(desired_update_freq_, &UnitreeHWLoop::update, this);
+}
+
+UnitreeHWLoop::~UnitreeHWLoop()
+{
+  loop_running_ = false;
+  if (loop_thread_.joinable())
+    loop_thread_.join();
 }
 
 void UnitreeHWLoop::update(const ros::TimerEvent& /*unused*/)
+{
+  update();
+}
+
+void UnitreeHWLoop::phaseLockedLoop()
+{
+  while (loop_running_ && ros::ok())
+  {
+    // Still run the controllers when the robot is silent, the commands are sent by the I/O thread anyway
+    if (!hardware_interface_->waitForState(2. * desired_update_freq_.toSec()))
+      ROS_WARN_THROTTLE(1., "No state received from the robot in %f s", 2. * desired_update_freq_.toSec());
+    update();
+  }
+}
+
+void UnitreeHWLoop::update()
 {
   // Get change in time
   current_time_ = steady_clock::now();
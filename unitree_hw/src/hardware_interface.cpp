@@ -5,6 +5,10 @@
 
 #include "unitree_hw/hardware_interface.h"
 
+#include <cheetah_common/ros_utilities.h>
+
+#include <algorithm>
+
 namespace cheetah_ros
 {
 bool UnitreeHW::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh)
@@ -14,74 +18,136 @@ bool UnitreeHW::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh)
     ROS_ERROR("Error occurred while setting up urdf");
     return false;
   }
-  setupJoints();
+  if (!setupJoints(robot_hw_nh))
+    return false;
   setupImu();
   setupContactSensor(robot_hw_nh);
 
-  udp_ = std::make_shared<UNITREE_LEGGED_SDK::UDP>(UNITREE_LEGGED_SDK::LOWLEVEL);
+  std::string robot_ip;
+  if (robot_hw_nh.getParam("robot_ip", robot_ip))
+  {
+    // E.g. 127.0.0.1 for unitree_emulator
+    udp_ = std::make_shared<UNITREE_LEGGED_SDK::UDP>(
+        getParam(robot_hw_nh, "local_port", UNITREE_LEGGED_SDK::UDP_CLIENT_PORT), robot_ip.c_str(),
+        getParam(robot_hw_nh, "robot_port", UNITREE_LEGGED_SDK::UDP_SERVER_PORT), sizeof(UNITREE_LEGGED_SDK::LowCmd),
+        sizeof(UNITREE_LEGGED_SDK::LowState));
+    udp_->SwitchLevel(UNITREE_LEGGED_SDK::LOWLEVEL);  // Also set the packet length and crc of the low level
+  }
+  else
+    udp_ = std::make_shared<UNITREE_LEGGED_SDK::UDP>(UNITREE_LEGGED_SDK::LOWLEVEL);
   udp_->InitCmdData(low_cmd_);
+  // The SDK link is only touched by the I/O thread from now on
+  udp_io_ = std::make_shared<UnitreeUdpIo>(udp_, getParam(robot_hw_nh, "io_poll_period", 20e-6),
+                                           getParam(robot_hw_nh, "io_send_period", 0.002),
+                                           getParam(robot_hw_nh, "state_period", 0.001));
+  udp_io_->start(low_cmd_);
 
   safety_ = std::make_shared<UNITREE_LEGGED_SDK::Safety>(UNITREE_LEGGED_SDK::LeggedType::Aliengo);
 
   actuator_state_pub_.reset(
       new realtime_tools::RealtimePublisher<cheetah_msgs::MotorState>(root_nh, "/motor_states", 100));
+
+  stale_timeout_ = getParam(robot_hw_nh, "stale_timeout", 0.01);
+  damping_kd_ = getParam(robot_hw_nh, "damping_kd", 5.);
+  diag_pub_ = std::make_shared<realtime_tools::RealtimePublisher<diagnostic_msgs::DiagnosticArray>>(
+      root_nh, "/diagnostics", 10);
+  diag_pub_->msg_.status.resize(1);
+  diag_pub_->msg_.status[0].name = "udp_link";
+  diag_pub_->msg_.status[0].hardware_id = "unitree_hw";
+  diag_pub_->msg_.status[0].message.reserve(REALTIME_STRING_CAPACITY);
+  const char* keys[] = { "received", "lost", "send_errors", "jitter", "max_inter_arrival", "stale", "bad_ticks" };
+  for (const char* key : keys)
+  {
+    // Reserve in place, a copy of the value would not keep the capacity
+    diag_pub_->msg_.status[0].values.emplace_back();
+    diag_pub_->msg_.status[0].values.back().key = key;
+    diag_pub_->msg_.status[0].values.back().value.reserve(REALTIME_STRING_CAPACITY);
+  }
   return true;
 }
 
 void UnitreeHW::read(const ros::Time& time, const ros::Duration& period)
 {
-  udp_->Recv();
-  udp_->GetRecv(low_state_);
-
-  for (int i = 0; i < 20; ++i)
+  uint64_t last_seq = low_state_.seq_;
+  if (udp_io_->getState(low_state_))
   {
-    joint_data_[i].pos_ = low_state_.motorState[i].q;
-    joint_data_[i].vel_ = low_state_.motorState[i].dq;
-    joint_data_[i].tau_ = low_state_.motorState[i].tauEst;
+    window_received_ += low_state_.seq_ - last_seq;
+    window_max_inter_arrival_ = std::max(window_max_inter_arrival_, low_state_.inter_arrival_);
   }
+  stale_ = low_state_.seq_ == 0 ||
+           std::chrono::steady_clock::now() - low_state_.stamp_ > std::chrono::duration<double>(stale_timeout_);
+  publishLinkDiagnostics(time);
 
-  imu_data_.ori[0] = low_state_.imu.quaternion[1];
-  imu_data_.ori[1] = low_state_.imu.quaternion[2];
-  imu_data_.ori[2] = low_state_.imu.quaternion[3];
-  imu_data_.ori[3] = low_state_.imu.quaternion[0];
-  imu_data_.angular_vel[0] = low_state_.imu.gyroscope[0];
-  imu_data_.angular_vel[1] = low_state_.imu.gyroscope[1];
-  imu_data_.angular_vel[2] = low_state_.imu.gyroscope[2];
-  imu_data_.linear_acc[0] = low_state_.imu.accelerometer[0];
-  imu_data_.linear_acc[1] = low_state_.imu.accelerometer[1];
-  imu_data_.linear_acc[2] = low_state_.imu.accelerometer[2];
+  for (int i = 0; i < 12; ++i)
+  {
+    const UNITREE_LEGGED_SDK::MotorState& motor = low_state_.state_.motorState[motor_index_[i]];
+    joints_.pos_[i] = motor.q;
+    joints_.vel_[i] = motor.dq;
+    joints_.tau_[i] = motor.tauEst;
+  }
 
-  contact_state_[LegPrefix::FL] = low_state_.footForce[UNITREE_LEGGED_SDK::FL_] > contact_threshold_;
-  contact_state_[LegPrefix::FR] = low_state_.footForce[UNITREE_LEGGED_SDK::FR_] > contact_threshold_;
-  contact_state_[LegPrefix::RL] = low_state_.footForce[UNITREE_LEGGED_SDK::RL_] > contact_threshold_;
-  contact_state_[LegPrefix::RR] = low_state_.footForce[UNITREE_LEGGED_SDK::RR_] > contact_threshold_;
+  imu_data_.ori[0] = low_state_.state_.imu.quaternion[1];
+  imu_data_.ori[1] = low_state_.state_.imu.quaternion[2];
+  imu_data_.ori[2] = low_state_.state_.imu.quaternion[3];
+  imu_data_.ori[3] = low_state_.state_.imu.quaternion[0];
+  imu_data_.angular_vel[0] = low_state_.state_.imu.gyroscope[0];
+  imu_data_.angular_vel[1] = low_state_.state_.imu.gyroscope[1];
+  imu_data_.angular_vel[2] = low_state_.state_.imu.gyroscope[2];
+  imu_data_.linear_acc[0] = low_state_.state_.imu.accelerometer[0];
+  imu_data_.linear_acc[1] = low_state_.state_.imu.accelerometer[1];
+  imu_data_.linear_acc[2] = low_state_.state_.imu.accelerometer[2];
 
-  // Set feedforward and velocity cmd to zero to avoid for saft when not controller setCommand
-  std::vector<std::string> names = hybrid_joint_interface_.getNames();
-  for (const auto& name : names)
+  contact_estimator_.begin();
+  for (int leg = 0; leg < 4; ++leg)
+    contact_estimator_.addForce(leg, low_state_.state_.footForce[foot_index_[leg]]);
+  contact_estimator_.end();
+  for (int leg = 0; leg < 4; ++leg)
   {
-    HybridJointHandle handle = hybrid_joint_interface_.getHandle(name);
-    handle.setFeedforward(0.);
-    handle.setVelocityDesired(0.);
+    contact_state_[leg] = contact_estimator_.isContact(leg);
+    contact_probability_[leg] = contact_estimator_.getProbability(leg);
+    double count = low_state_.state_.footForce[foot_index_[leg]] - contact_estimator_.getForceOffset(leg);
+    contact_force_[leg] = count * newton_per_count_[leg];
   }
+
+  ++generation_;
+  applySafeDefault(false);
 }
 
 void UnitreeHW::write(const ros::Time& time, const ros::Duration& period)
 {
-  for (int i = 0; i < 20; ++i)
+  applySafeDefault(true);
+  for (int i = 0; i < 12; ++i)
   {
-    low_cmd_.motorCmd[i].q = joint_data_[i].pos_des_;
-    low_cmd_.motorCmd[i].dq = joint_data_[i].vel_des_;
-    low_cmd_.motorCmd[i].Kp = joint_data_[i].kp_;
-    low_cmd_.motorCmd[i].Kd = joint_data_[i].kd_;
-    low_cmd_.motorCmd[i].tau = joint_data_[i].ff_;
+    UNITREE_LEGGED_SDK::MotorCmd& motor = low_cmd_.motorCmd[motor_index_[i]];
+    motor.q = joints_.pos_des_[i];
+    motor.dq = joints_.vel_des_[i];
+    motor.Kp = joints_.kp_[i];
+    motor.Kd = joints_.kd_[i];
+    motor.tau = joints_.ff_[i];
+  }
+  if (stale_)
+  {
+    // The controllers run on an outdated state, only damp the joints until the link recovers
+    for (int i = 0; i < 12; ++i)
+    {
+      UNITREE_LEGGED_SDK::MotorCmd& motor = low_cmd_.motorCmd[motor_index_[i]];
+      motor.q = joints_.pos_[i];
+      motor.dq = 0.;
+      motor.Kp = 0.;
+      motor.Kd = damping_kd_;
+      motor.tau = 0.;
+    }
   }
   safety_->PositionLimit(low_cmd_);
-  udp_->SetSend(low_cmd_);
-  udp_->Send();
+  udp_io_->setCommand(low_cmd_);
   publishMotorState(time);
 }
 
+bool UnitreeHW::waitForState(double timeout) const
+{
+  return udp_io_->waitForState(low_state_.seq_, timeout);
+}
+
 bool UnitreeHW::loadUrdf(ros::NodeHandle& root_nh)
 {
   if (urdf_model_ == nullptr)
@@ -91,40 +157,74 @@ bool UnitreeHW::loadUrdf(ros::NodeHandle& root_nh)
   return !urdf_string_.empty() && urdf_model_->initString(urdf_string_);
 }
 
-bool UnitreeHW::setupJoints()
+bool UnitreeHW::setupJoints(ros::NodeHandle& nh)
 {
+  std::vector<std::string> urdf_joints;
   for (const auto& joint : urdf_model_->joints_)
+    urdf_joints.push_back(joint.first);
+  if (!robot_description_.init(nh, urdf_joints))
+    return false;
+  if (robot_description_.getNumLegs() != 4 || robot_description_.getJointsPerLeg() != 3)
   {
-    int leg_index, joint_index;
-    if (joint.first.find("FR") != std::string::npos)
-      leg_index = UNITREE_LEGGED_SDK::FR_;
-    else if (joint.first.find("FL") != std::string::npos)
-      leg_index = UNITREE_LEGGED_SDK::FL_;
-    else if (joint.first.find("RR") != std::string::npos)
-      leg_index = UNITREE_LEGGED_SDK::RR_;
-    else if (joint.first.find("RL") != std::string::npos)
-      leg_index = UNITREE_LEGGED_SDK::RL_;
-    else
-      continue;
-    if (joint.first.find("hip") != std::string::npos)
-      joint_index = 0;
-    else if (joint.first.find("thigh") != std::string::npos)
-      joint_index = 1;
-    else if (joint.first.find("calf") != std::string::npos)
-      joint_index = 2;
-    else
-      continue;
+    ROS_ERROR("The SDK drives 4 legs of 3 joints, check /robot_legs");
+    return false;
+  }
+
+  // Slot of every joint in motorCmd and motorState, e.g. motor_index: [ 3, 4, 5, 0, 1, 2, 9, 10, 11, 6, 7, 8 ]
+  XmlRpc::XmlRpcValue motor_index;
+  if (nh.getParam("motor_index", motor_index))
+  {
+    if (motor_index.getType() != XmlRpc::XmlRpcValue::TypeArray || motor_index.size() != 12)
+    {
+      ROS_ERROR("motor_index should be a list of 12 slots");
+      return false;
+    }
+    for (int i = 0; i < 12; ++i)
+      motor_index_[i] = static_cast<int>(motor_index[i]);
+  }
+  else
+  {
+    // The legs of the unitree urdf, in the order of the SDK
+    static const std::string sdk_legs[4] = { "FR", "FL", "RR", "RL" };
+    for (int leg = 0; leg < 4; ++leg)
+    {
+      auto sdk_leg = static_cast<int>(std::find(sdk_legs, sdk_legs + 4, robot_description_.getLegName(leg)) - sdk_legs);
+      if (sdk_leg == 4)
+      {
+        ROS_ERROR_STREAM("The leg " << robot_description_.getLegName(leg) << " is not in the SDK, set motor_index");
+        return false;
+      }
+      for (int joint = 0; joint < 3; ++joint)
+        motor_index_[leg * 3 + joint] = sdk_leg * 3 + joint;
+    }
+  }
+  for (int i = 0; i < 12; ++i)
+    if (motor_index_[i] < 0 || motor_index_[i] >= 12)
+    {
+      ROS_ERROR_STREAM("The slot " << motor_index_[i] << " of " << robot_description_.getJointName(i)
+                                   << " is not a motor of the legs");
+      return false;
+    }
+  // footForce has one slot per leg of the SDK
+  for (int leg = 0; leg < 4; ++leg)
+    foot_index_[leg] = motor_index_[leg * 3] / 3;
 
-    int index = leg_index * 3 + joint_index;
-    hardware_interface::JointStateHandle state_handle(joint.first, &joint_data_[index].pos_, &joint_data_[index].vel_,
-                                                      &joint_data_[index].tau_);
+  for (int i = 0; i < 12; ++i)
+  {
+    hardware_interface::JointStateHandle state_handle(robot_description_.getJointName(i), &joints_.pos_[i],
+                                                      &joints_.vel_[i], &joints_.tau_[i]);
     joint_state_interface_.registerHandle(state_handle);
-    hybrid_joint_interface_.registerHandle(HybridJointHandle(state_handle, &joint_data_[index].pos_des_,
-                                                             &joint_data_[index].vel_des_, &joint_data_[index].kp_,
-                                                             &joint_data_[index].kd_, &joint_data_[index].ff_));
+    hybrid_joint_interface_.registerHandle(HybridJointHandle(state_handle, &joints_.pos_des_[i], &joints_.vel_des_[i],
+                                                             &joints_.kp_[i], &joints_.kd_[i], &joints_.ff_[i],
+                                                             &generation_, &joints_.cmd_generation_[i]));
   }
+  // The same joints in the order of the robot description, for the controllers which write all of them at once
+  hybrid_joint_block_interface_.registerHandle(HybridJointBlockHandle(
+      "legs", 12, joints_.pos_, joints_.vel_, joints_.tau_, joints_.pos_des_, joints_.vel_des_, joints_.kp_,
+      joints_.kd_, joints_.ff_, &generation_, joints_.cmd_generation_));
   registerInterface(&joint_state_interface_);
   registerInterface(&hybrid_joint_interface_);
+  registerInterface(&hybrid_joint_block_interface_);
   return true;
 }
 
@@ -139,12 +239,51 @@ bool UnitreeHW::setupImu()
 
 bool UnitreeHW::setupContactSensor(ros::NodeHandle& nh)
 {
-  nh.getParam("contact_threshold", contact_threshold_);
-  contact_sensor_interface_.registerHandle(ContactSensorHandle("feet", contact_state_));
+  // The old fixed threshold is the default of the calibration of every foot
+  double threshold = getParam(nh, "contact_threshold", 10.);
+  // The estimator works on the raw counts, the force exposed to the controllers is in newton as in the simulations
+  double newton_per_count = getParam(nh, "contact/newton_per_count", 1.);
+  XmlRpc::XmlRpcValue contact_params;
+  nh.getParam("contact", contact_params);
+  for (int leg = 0; leg < 4; ++leg)
+  {
+    // E.g. contact/FL/offset, or contact/offset for all the feet
+    const std::string& name = robot_description_.getLegName(leg);
+    XmlRpc::XmlRpcValue foot_params = contact_params.hasMember(name) ? contact_params[name] : contact_params;
+    contact_estimator_.setForceCalibration(leg, xmlRpcGetDouble(foot_params, "offset", 0.),
+                                           xmlRpcGetDouble(foot_params, "threshold", threshold),
+                                           xmlRpcGetDouble(foot_params, "scale", 5.));
+    newton_per_count_[leg] = xmlRpcGetDouble(foot_params, "newton_per_count", newton_per_count);
+  }
+  contact_estimator_.setHysteresis(getParam(nh, "contact/high", 0.7), getParam(nh, "contact/low", 0.3));
+  contact_estimator_.setOffsetTracking(getParam(nh, "contact/offset_rate", 0.));
+  contact_sensor_interface_.registerHandle(
+      ContactSensorHandle("feet", contact_state_, contact_probability_, contact_force_));
   registerInterface(&contact_sensor_interface_);
   return true;
 }
 
+void UnitreeHW::applySafeDefault(bool cycle_end)
+{
+  for (int i = 0; i < 12; ++i)
+  {
+    if (!cycle_end)
+    {
+      // Set feedforward and velocity cmd to zero for safety when no controller setCommand
+      joints_.ff_[i] = 0.;
+      joints_.vel_des_[i] = 0.;
+    }
+    else if (joints_.cmd_generation_[i] != generation_)
+    {
+      // No controller updated the command in this cycle, e.g. the controller is stopped or crashed
+      joints_.kp_[i] = 0.;
+      joints_.kd_[i] = 0.;
+      joints_.ff_[i] = 0.;
+      joints_.vel_des_[i] = 0.;
+    }
+  }
+}
+
 void UnitreeHW::publishMotorState(const ros::Time& time)
 {
   if (last_publish_time_ + ros::Duration(1.0 / 100.0) < time)
@@ -155,10 +294,10 @@ void UnitreeHW::publishMotorState(const ros::Time& time)
       motor_state.header.stamp = time;
       for (int i = 0; i < 20; ++i)
       {
-        motor_state.q[i] = low_state_.motorState[i].q;
-        motor_state.dq[i] = low_state_.motorState[i].dq;
-        motor_state.tau[i] = low_state_.motorState[i].tauEst;
-        motor_state.temperature[i] = low_state_.motorState[i].temperature;
+        motor_state.q[i] = low_state_.state_.motorState[i].q;
+        motor_state.dq[i] = low_state_.state_.motorState[i].dq;
+        motor_state.tau[i] = low_state_.state_.motorState[i].tauEst;
+        motor_state.temperature[i] = low_state_.state_.motorState[i].temperature;
         motor_state.q_des[i] = low_cmd_.motorCmd[i].q;
         motor_state.dq_des[i] = low_cmd_.motorCmd[i].dq;
         motor_state.ff[i] = low_cmd_.motorCmd[i].tau;
@@ -170,4 +309,58 @@ void UnitreeHW::publishMotorState(const ros::Time& time)
   }
 }
 
+void UnitreeHW::publishLinkDiagnostics(const ros::Time& time)
+{
+  if (time < last_diag_)
+    last_diag_ = time;
+  if (time - last_diag_ < ros::Duration(1.))
+    return;
+  if (diag_pub_->trylock())
+  {
+    last_diag_ = time;
+    // The receive error counters of the SDK also count every poll without a packet, so the lost packets are counted
+    // from the tick of the robot instead, and a corrupted packet shows up as a lost one
+    uint64_t lost = low_state_.lost_ - window_start_lost_;
+    uint64_t bad_ticks = low_state_.bad_ticks_ - window_start_bad_ticks_;
+    unsigned long long send_errors = low_state_.udp_state_.SendError - window_start_.SendError;
+    diagnostic_msgs::DiagnosticStatus& status = diag_pub_->msg_.status[0];
+    if (stale_)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      status.message = "Stale state, damping mode";
+    }
+    else if (lost > 0 || send_errors > 0)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "Packet loss";
+    }
+    else if (bad_ticks > 0)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "Tick not advancing or reset";
+    }
+    else
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "OK";
+    }
+    // Filled in the real time loop, so the strings are reused instead of allocated
+    formatNumber(status.values[0].value, window_received_);
+    formatNumber(status.values[1].value, lost);
+    formatNumber(status.values[2].value, send_errors);
+    formatNumber(status.values[3].value, low_state_.jitter_);
+    formatNumber(status.values[4].value, window_max_inter_arrival_);
+    status.values[5].value = stale_ ? "true" : "false";
+    formatNumber(status.values[6].value, bad_ticks);
+    diag_pub_->msg_.header.stamp = time;
+    diag_pub_->unlockAndPublish();
+
+    window_start_ = low_state_.udp_state_;
+    window_start_lost_ = low_state_.lost_;
+    window_start_bad_ticks_ = low_state_.bad_ticks_;
+    window_received_ = 0;
+    window_max_inter_arrival_ = 0.;
+  }
+}
+
 }  // namespace cheetah_ros
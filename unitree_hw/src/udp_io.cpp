@@ -0,0 +1,124 @@
+#include "unitree_hw/udp_io.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cheetah_ros
+{
+using namespace std::chrono;
+
+// A larger gap of the tick is a reset of the robot rather than lost packets
+const double MAX_TICK_GAP = 1.;
+
+UnitreeUdpIo::UnitreeUdpIo(std::shared_ptr<UNITREE_LEGGED_SDK::UDP> udp, double poll_period, double send_period,
+                           double state_period)
+  : udp_(std::move(udp))
+  , poll_period_(duration_cast<steady_clock::duration>(duration<double>(poll_period)))
+  , send_period_(duration_cast<steady_clock::duration>(duration<double>(send_period)))
+  , state_period_(state_period)
+{
+}
+
+UnitreeUdpIo::~UnitreeUdpIo()
+{
+  stop();
+}
+
+void UnitreeUdpIo::start(const UNITREE_LEGGED_SDK::LowCmd& initial_cmd)
+{
+  if (running_)
+    return;
+  setCommand(initial_cmd);
+  cmd_buffer_.update();
+  running_ = true;
+  thread_ = std::thread(&UnitreeUdpIo::loop, this);
+}
+
+void UnitreeUdpIo::stop()
+{
+  running_ = false;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+bool UnitreeUdpIo::getState(StampedLowState& state)
+{
+  if (!state_buffer_.update())
+    return false;
+  state = state_buffer_.front();
+  return true;
+}
+
+void UnitreeUdpIo::setCommand(const UNITREE_LEGGED_SDK::LowCmd& cmd)
+{
+  cmd_buffer_.back() = cmd;
+  cmd_buffer_.publish();
+}
+
+bool UnitreeUdpIo::waitForState(uint64_t seq, double timeout) const
+{
+  steady_clock::time_point deadline =
+      steady_clock::now() + duration_cast<steady_clock::duration>(duration<double>(timeout));
+  while (seq_.load(std::memory_order_acquire) <= seq)
+  {
+    if (steady_clock::now() > deadline)
+      return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+void UnitreeUdpIo::loop()
+{
+  last_send_ = steady_clock::now();
+  while (running_)
+  {
+    unsigned long long recv_count = udp_->udpState.RecvCount;
+    udp_->Recv();
+    steady_clock::time_point now = steady_clock::now();
+    if (udp_->udpState.RecvCount != recv_count)
+    {
+      StampedLowState& state = state_buffer_.back();
+      udp_->GetRecv(state.state_);
+      state.stamp_ = now;
+      state.seq_ = seq_.load(std::memory_order_relaxed) + 1;
+      state.inter_arrival_ = state.seq_ > 1 ? duration<double>(now - last_arrival_).count() : 0.;
+      if (state.seq_ > 1)
+      {
+        // The tick is in us and wraps around, the unsigned difference handles it
+        double tick_diff = static_cast<uint32_t>(state.state_.tick - last_tick_) * 1e-6;
+        if (tick_diff > 0. && tick_diff < MAX_TICK_GAP)
+        {
+          jitter_ += (std::abs(state.inter_arrival_ - tick_diff) - jitter_) / 16.;
+          lost_ += static_cast<uint64_t>(std::max(std::lround(tick_diff / state_period_) - 1, 0L));
+        }
+        else
+          ++bad_ticks_;  // A tick which does not advance or jumps says nothing about the link
+      }
+      state.jitter_ = jitter_;
+      state.lost_ = lost_;
+      state.bad_ticks_ = bad_ticks_;
+      state.udp_state_ = udp_->udpState;
+      last_arrival_ = now;
+      last_tick_ = state.state_.tick;
+      state_buffer_.publish();
+      seq_.store(state.seq_, std::memory_order_release);
+      send();
+    }
+    else if (now - last_send_ >= send_period_)
+      send();
+    else if (poll_period_.count() > 0)
+      std::this_thread::sleep_for(poll_period_);
+  }
+}
+
+void UnitreeUdpIo::send()
+{
+  cmd_buffer_.update();
+  UNITREE_LEGGED_SDK::LowCmd cmd = cmd_buffer_.front();  // The SDK takes a non const reference
+  udp_->SetSend(cmd);
+  udp_->Send();
+  last_send_ = steady_clock::now();
+}
+
+}  // namespace cheetah_ros
@@ -0,0 +1,249 @@
+// Emulate the low level UDP interface of an Unitree robot on the local machine, for running and benchmarking unitree_hw
+// without a robot. The robot is hung up: every joint is an independent inertia driven by the motor PD of LowCmd, or
+// the joint states are replayed from a text log (one line per tick: 12 positions, 12 velocities then optionally the 4
+// footForce). The packets are in the wire format of the prebuilt SDK library, see wire_format.h.
+// Usage: unitree_emulator [--port 8007] [--rate 1000] [--replay log.txt]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "unitree_hw/wire_format.h"
+
+namespace
+{
+using namespace std::chrono;
+using UNITREE_LEGGED_SDK::LowCmd;
+using UNITREE_LEGGED_SDK::LowState;
+namespace wire = cheetah_ros::unitree_wire;
+
+struct JointModel
+{
+  double inertia_, damping_;  // Reflected inertia of the rotor and the link, viscous friction
+};
+
+class UnitreeEmulator
+{
+public:
+  UnitreeEmulator(uint16_t port, double rate, std::vector<std::vector<float>> replay)
+    : dt_(1. / rate), replay_(std::move(replay))
+  {
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd_ < 0 || bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+      throw std::runtime_error("Can not bind the port " + std::to_string(port) + ": " + std::strerror(errno));
+    timeval timeout{ 0, 100 };
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::memset(&state_, 0, sizeof(state_));
+    std::memset(&cmd_, 0, sizeof(cmd_));
+    state_.levelFlag = UNITREE_LEGGED_SDK::LOWLEVEL;
+    state_.imu.quaternion[0] = 1.;
+    state_.imu.accelerometer[2] = 9.81;
+    for (int i = 0; i < 12; ++i)
+    {
+      cmd_.motorCmd[i].q = UNITREE_LEGGED_SDK::PosStopF;
+      cmd_.motorCmd[i].dq = UNITREE_LEGGED_SDK::VelStopF;
+      joints_[i] = JointModel{ .inertia_ = 0.02, .damping_ = 0.1 };
+    }
+  }
+
+  ~UnitreeEmulator()
+  {
+    close(fd_);
+  }
+
+  void run()
+  {
+    steady_clock::time_point next = steady_clock::now(), last_report = next;
+    while (true)
+    {
+      // Receive every command until the next tick
+      while (steady_clock::now() < next)
+        receive();
+      next += duration_cast<steady_clock::duration>(duration<double>(dt_));
+      step();
+      send();
+      if (steady_clock::now() - last_report > seconds(1))
+      {
+        report();
+        last_report = steady_clock::now();
+      }
+    }
+  }
+
+private:
+  void receive()
+  {
+    alignas(4) char buffer[2048];
+    sockaddr_in from{};
+    socklen_t from_len = sizeof(from);
+    ssize_t len = recvfrom(fd_, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&from), &from_len);
+    if (len < 0)
+      return;
+    if (static_cast<size_t>(len) != wire::LOW_CMD_LENGTH || !wire::checkCrc(buffer, len))
+    {
+      ++crc_errors_;
+      return;
+    }
+    client_ = from;
+    has_client_ = true;
+    wire::parseLowCmd(buffer, cmd_);
+    ++received_;
+    // Time from the last state to the command replying it, i.e. the loop of unitree_hw plus the sockets
+    if (waiting_reply_)
+    {
+      double latency = duration<double>(steady_clock::now() - last_send_).count();
+      latency_sum_ += latency;
+      latency_max_ = std::max(latency_max_, latency);
+      ++replies_;
+      waiting_reply_ = false;
+    }
+  }
+
+  void step()
+  {
+    state_.tick += static_cast<uint32_t>(dt_ * 1e6);
+    if (!replay_.empty())
+    {
+      const std::vector<float>& line = replay_[replay_index_++ % replay_.size()];
+      for (int i = 0; i < 12; ++i)
+      {
+        state_.motorState[i].q = line[i];
+        state_.motorState[i].dq = line[12 + i];
+        state_.motorState[i].tauEst = cmd_.motorCmd[i].tau;
+      }
+      for (size_t leg = 0; leg < 4 && 24 + leg < line.size(); ++leg)
+        state_.footForce[leg] = static_cast<int16_t>(line[24 + leg]);
+      return;
+    }
+    for (int i = 0; i < 12; ++i)
+    {
+      const UNITREE_LEGGED_SDK::MotorCmd& cmd = cmd_.motorCmd[i];
+      UNITREE_LEGGED_SDK::MotorState& state = state_.motorState[i];
+      double tau = cmd.tau - cmd.Kd * state.dq;
+      if (std::abs(cmd.q) < UNITREE_LEGGED_SDK::PosStopF)
+        tau += cmd.Kp * (cmd.q - state.q);
+      if (std::abs(cmd.dq) < UNITREE_LEGGED_SDK::VelStopF)
+        tau += cmd.Kd * cmd.dq;
+      double ddq = (tau - joints_[i].damping_ * state.dq) / joints_[i].inertia_;
+      state.dq += ddq * dt_;
+      state.q += state.dq * dt_;
+      state.ddq = ddq;
+      state.tauEst = tau;
+    }
+  }
+
+  void send()
+  {
+    if (!has_client_)
+      return;
+    alignas(4) char buffer[wire::LOW_STATE_LENGTH];
+    wire::serializeLowState(state_, buffer);
+    wire::setCrc(buffer, wire::LOW_STATE_LENGTH);
+    sendto(fd_, buffer, wire::LOW_STATE_LENGTH, 0, reinterpret_cast<sockaddr*>(&client_), sizeof(client_));
+    last_send_ = steady_clock::now();
+    waiting_reply_ = true;
+  }
+
+  void report()
+  {
+    std::cout << "cmd: " << received_ << " Hz, crc errors: " << crc_errors_ << ", reply latency mean: "
+              << (replies_ > 0 ? latency_sum_ / replies_ * 1e6 : 0.) << " us, max: " << latency_max_ * 1e6 << " us"
+              << std::endl;
+    received_ = 0;
+    crc_errors_ = 0;
+    replies_ = 0;
+    latency_sum_ = 0.;
+    latency_max_ = 0.;
+  }
+
+  int fd_;
+  double dt_;
+  std::vector<std::vector<float>> replay_;
+  size_t replay_index_{};
+  JointModel joints_[12]{};
+  LowState state_{};
+  LowCmd cmd_{};
+
+  sockaddr_in client_{};
+  bool has_client_{ false };
+  steady_clock::time_point last_send_;
+  bool waiting_reply_{ false };
+
+  // Statistics in the last second
+  uint64_t received_{}, crc_errors_{}, replies_{};
+  double latency_sum_{}, latency_max_{};
+};
+
+std::vector<std::vector<float>> loadReplay(const std::string& file)
+{
+  std::vector<std::vector<float>> replay;
+  std::ifstream stream(file);
+  if (!stream)
+    throw std::runtime_error("Can not open " + file);
+  std::string line;
+  while (std::getline(stream, line))
+  {
+    std::istringstream iss(line);
+    std::vector<float> values;
+    float value;
+    while (iss >> value)
+      values.push_back(value);
+    if (values.size() >= 24)
+      replay.push_back(values);
+  }
+  return replay;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  uint16_t port = 8007;
+  double rate = 1000.;
+  std::string replay_file;
+  // Unknown arguments (e.g. the remappings of roslaunch) are ignored
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--port")
+      port = static_cast<uint16_t>(std::stoi(argv[++i]));
+    else if (arg == "--rate")
+      rate = std::stod(argv[++i]);
+    else if (arg == "--replay")
+      replay_file = argv[++i];
+  }
+
+  try
+  {
+    std::vector<std::vector<float>> replay;
+    if (!replay_file.empty())
+      replay = loadReplay(replay_file);
+    UnitreeEmulator emulator(port, rate, replay);
+    std::cout << "Emulate the robot on 127.0.0.1:" << port << " at " << rate << " Hz" << std::endl;
+    emulator.run();
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
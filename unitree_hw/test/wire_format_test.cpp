@@ -0,0 +1,172 @@
+// Round trip a known LowCmd and LowState between the SDK library and wire_format.h over the loopback, i.e. check that
+// the emulator speaks the same packets as UDP::SetSend and UDP::GetRecv of the robot.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "unitree_hw/wire_format.h"
+#include "unitree_legged_sdk/udp.h"
+
+using namespace UNITREE_LEGGED_SDK;
+namespace wire = cheetah_ros::unitree_wire;
+
+const uint16_t SDK_PORT = 9301, PEER_PORT = 9302;
+
+bool check(bool condition, const char* what)
+{
+  if (!condition)
+    std::cout << "FAIL: " << what << std::endl;
+  return condition;
+}
+
+// The torques and gains are multiples of the scales of the int16 fields, so that they go through unchanged
+LowCmd knownCmd()
+{
+  LowCmd cmd;
+  std::memset(&cmd, 0, sizeof(cmd));
+  cmd.levelFlag = LOWLEVEL;
+  cmd.commVersion = 0x1122;
+  cmd.robotID = 0x3344;
+  cmd.SN = 0x55667788;
+  cmd.bandWidth = 0x99;
+  for (int i = 0; i < 20; ++i)
+  {
+    MotorCmd& motor = cmd.motorCmd[i];
+    motor.mode = 0x0A;
+    motor.q = 0.1f * i - 1.f;
+    motor.dq = i == 0 ? static_cast<float>(VelStopF) : 0.5f * i;
+    motor.tau = -3.25f + 0.5f * i;
+    motor.Kp = 40.5f + i;
+    motor.Kd = 0.75f + 0.0625f * i;
+    motor.reserve[0] = 0xA0A0A000 + i;
+    motor.reserve[1] = 0xB0B0B000 + i;
+    motor.reserve[2] = 0xC0C0C000 + i;
+  }
+  for (int i = 0; i < 4; ++i)
+    cmd.led[i] = LED{ static_cast<uint8_t>(0xD0 + i), static_cast<uint8_t>(0xE0 + i), static_cast<uint8_t>(0xF0 + i) };
+  for (int i = 0; i < 40; ++i)
+    cmd.wirelessRemote[i] = static_cast<uint8_t>(0x60 + i);
+  cmd.reserve = 0x12345678;
+  return cmd;
+}
+
+LowState knownState()
+{
+  LowState state;
+  std::memset(&state, 0, sizeof(state));
+  state.levelFlag = LOWLEVEL;
+  state.commVersion = 0x1122;
+  state.robotID = 0x3344;
+  state.SN = 0x55667788;
+  state.bandWidth = 0x99;
+  state.imu.quaternion[0] = 1.f;
+  state.imu.gyroscope[2] = 0.25f;
+  state.imu.accelerometer[2] = 9.81f;
+  state.imu.rpy[1] = -0.125f;
+  state.imu.temperature = 35;
+  for (int i = 0; i < 20; ++i)
+  {
+    MotorState& motor = state.motorState[i];
+    motor.mode = 0x0A;
+    motor.q = 0.1f * i - 1.f;
+    motor.dq = 0.3f * i;
+    motor.ddq = -100.f + 17.f * i;
+    motor.tauEst = -7.5f + 0.5f * i + 1.f / 256.f;
+    motor.q_raw = 0.2f * i;
+    motor.dq_raw = -0.4f * i;
+    motor.ddq_raw = 250.f - 3.f * i;
+    motor.temperature = static_cast<int8_t>(30 + i);
+    motor.reserve[0] = 0xA0A0A000 + i;
+    motor.reserve[1] = 0xB0B0B000 + i;
+  }
+  for (int leg = 0; leg < 4; ++leg)
+    state.footForce[leg] = static_cast<int16_t>(100 * leg - 20);
+  state.tick = 0x89ABCDEF;
+  for (int i = 0; i < 40; ++i)
+    state.wirelessRemote[i] = static_cast<uint8_t>(0x60 + i);
+  state.reserve = 0x12345678;
+  return state;
+}
+
+bool testCmd(UDP& udp, int fd)
+{
+  LowCmd cmd = knownCmd();
+  udp.SetSend(cmd);
+  udp.Send();
+  alignas(4) char buffer[2048];
+  ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+  bool pass = check(len == static_cast<ssize_t>(wire::LOW_CMD_LENGTH), "length of the command");
+  if (!pass)
+    return false;
+  pass &= check(wire::checkCrc(buffer, len), "crc of the command");
+  LowCmd parsed;
+  wire::parseLowCmd(buffer, parsed);
+  parsed.crc = cmd.crc;
+  pass &= check(std::memcmp(&parsed, &cmd, sizeof(cmd)) == 0, "command parsed back");
+  return pass;
+}
+
+bool testState(UDP& udp, int fd)
+{
+  LowState state = knownState();
+  alignas(4) char buffer[wire::LOW_STATE_LENGTH];
+  wire::serializeLowState(state, buffer);
+  wire::setCrc(buffer, wire::LOW_STATE_LENGTH);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(SDK_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sendto(fd, buffer, wire::LOW_STATE_LENGTH, 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  usleep(10000);
+  udp.Recv();
+  LowState received;
+  std::memset(&received, 0, sizeof(received));
+  udp.GetRecv(received);
+  bool pass = check(udp.udpState.RecvCRCError == 0, "crc of the state");
+  // footForceEst is not on the wire and the crc is not copied
+  std::memset(state.footForceEst, 0, sizeof(state.footForceEst));
+  state.crc = received.crc;
+  pass &= check(std::memcmp(&received.imu, &state.imu, sizeof(state.imu)) == 0, "imu");
+  for (int i = 0; i < 20; ++i)
+  {
+    const MotorState &a = received.motorState[i], &b = state.motorState[i];
+    pass &= check(a.mode == b.mode && a.q == b.q && a.dq == b.dq && a.q_raw == b.q_raw && a.dq_raw == b.dq_raw &&
+                      a.temperature == b.temperature && std::memcmp(a.reserve, b.reserve, sizeof(a.reserve)) == 0,
+                  "motor state");
+    pass &= check(a.ddq == b.ddq && a.ddq_raw == b.ddq_raw && a.tauEst == b.tauEst, "int16 fields of a motor state");
+  }
+  pass &= check(std::memcmp(received.footForce, state.footForce, sizeof(state.footForce)) == 0, "footForce");
+  pass &= check(received.tick == state.tick, "tick");
+  pass &= check(std::memcmp(&received, &state, sizeof(state)) == 0, "whole state");
+  return pass;
+}
+
+int main()
+{
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PEER_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+  {
+    std::cout << "FAIL: can not bind the port " << PEER_PORT << std::endl;
+    return 1;
+  }
+  timeval timeout{ 1, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  UDP udp(SDK_PORT, "127.0.0.1", PEER_PORT, sizeof(LowCmd), sizeof(LowState));
+  udp.SwitchLevel(LOWLEVEL);
+  bool cmd = testCmd(udp, fd);
+  bool state = testState(udp, fd);
+  close(fd);
+  bool pass = cmd && state;
+  std::cout << "Wire format: " << (pass ? "PASS" : "FAIL") << std::endl;
+  return pass ? 0 : 1;
+}